@@ -0,0 +1,14 @@
+#include <cstdarg>
+#include "Arduino.h"
+
+uint64_t hostTime = 0;
+HostSerial Serial;
+
+int HostSerial::printf(const char *format, ...)
+{
+  va_list args;
+  va_start(args, format);
+  int n = vprintf(format, args);
+  va_end(args);
+  return n;
+}
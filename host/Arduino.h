@@ -0,0 +1,44 @@
+#ifndef __HOST_ARDUINO_H__
+#define __HOST_ARDUINO_H__
+
+// minimal Arduino API for the host build (env:native)
+// time is virtual: it only advances by delay()/delayMicroseconds() and
+// by the emulated bus, so runs are fast and reproducible
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#define IRAM_ATTR
+#define HIGH    1
+#define LOW     0
+#define RISING  1
+#define FALLING 2
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+// virtual clock in micros
+extern uint64_t hostTime;
+
+inline uint32_t micros(void) { return (uint32_t)hostTime; }
+inline uint32_t millis(void) { return (uint32_t)(hostTime / 1000); }
+inline void delayMicroseconds(uint32_t us) { hostTime += us; }
+inline void delay(uint32_t ms) { hostTime += (uint64_t)ms * 1000; }
+
+class HostSerial
+{
+  public:
+    int printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+    void print(const char *s) { fputs(s, stdout); }
+    void print(int i) { ::printf("%d", i); }
+    void println(void) { fputs("\n", stdout); }
+    void println(const char *s) { puts(s); }
+    void println(int i) { ::printf("%d\n", i); }
+};
+
+extern HostSerial Serial;
+
+#endif // __HOST_ARDUINO_H__
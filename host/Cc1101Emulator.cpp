@@ -0,0 +1,687 @@
+#include "Cc1101Emulator.h"
+#include "Cc1101Radio.h"
+
+const uint32_t CAL_TIME = 720;     // micros, SCAL / auto calibration
+const uint32_t SETTLE_TIME = 90;   // micros, IDLE to RX without calibration
+const uint32_t RESET_TIME = 40;    // micros, SRES until chip ready
+const uint32_t WAKEUP_TIME = 150;  // micros, SLEEP until chip ready
+const int16_t FREQ_CLEAN = 12;     // FREQEST steps the demodulator copes with
+const int16_t FREQ_LOCK = 32;      // FREQEST steps a sync word can be found at
+const int16_t CS_LEVEL = -100;     // dBm, absolute carrier sense threshold 0 dB
+const uint8_t CAL_FSCAL3 = 0xE9;   // FSCAL3 after a calibration, never written by the driver
+
+// reset values of the configuration registers 0x00 - 0x2E (datasheet table 41)
+static const uint8_t resetValues[0x2F] =
+{
+  0x29, 0x2E, 0x3F, 0x07, 0xD3, 0x91, 0xFF, 0x04,
+  0x45, 0x00, 0x00, 0x0F, 0x00, 0x1E, 0xC4, 0xEC,
+  0x8C, 0x22, 0x02, 0x22, 0xF8, 0x47, 0x07, 0x30,
+  0x04, 0x76, 0x6C, 0x03, 0x40, 0x91, 0x87, 0x6B,
+  0xF8, 0x56, 0x10, 0xA9, 0x0A, 0x20, 0x0D, 0x41,
+  0x00, 0x59, 0x7F, 0x3F, 0x88, 0x31, 0x0B
+};
+
+Cc1101Emulator::Cc1101Emulator(uint32_t byteTime, uint32_t spiByteTime, uint32_t csTime)
+  : byteTime (byteTime), spiByteTime (spiByteTime), csTime (csTime)
+{
+  gdo[0].iocfg = CC1101_IOCFG0;
+  gdo[1].iocfg = CC1101_IOCFG2;
+  resetChip();
+}
+
+void Cc1101Emulator::begin(void)
+{
+}
+
+void Cc1101Emulator::resetChip(void)
+{
+  memcpy(regs, resetValues, sizeof(resetValues));
+  regs[0x2F] = 0;
+  marcState = MARCSTATE_IDLE;
+  timed = false;
+  powerDown = false;
+  fifoHead = 0;
+  fifoCount = 0;
+  overflow = false;
+  inPacket = false;
+  packetEnded = false;
+}
+
+// time passes while the driver talks to the chip
+void Cc1101Emulator::spend(uint32_t us)
+{
+  hostTime += us;
+  process(hostTime);
+}
+
+void Cc1101Emulator::select(void)
+{
+  selected = true;
+  headerDone = false;
+  stats.spiTransactions++;
+
+  if (marcState == MARCSTATE_SLEEP)
+  {
+    // CS low wakes the chip up, MISO stays high until the crystal is stable
+    marcState = MARCSTATE_IDLE;
+    readyAt = hostTime + WAKEUP_TIME;
+  }
+
+  spend(csTime);
+}
+
+void Cc1101Emulator::deselect(void)
+{
+  selected = false;
+
+  if (powerDown)
+  {
+    // SPWD takes effect when CS goes high
+    powerDown = false;
+    marcState = MARCSTATE_SLEEP;
+    inPacket = false;
+    timed = false;
+    // datasheet: TEST2..TEST0 are not retained in SLEEP
+    memcpy(&regs[CC1101_TEST2], &resetValues[CC1101_TEST2], 3);
+  }
+}
+
+bool Cc1101Emulator::misoLow(void)
+{
+  spend(1);
+  return selected && hostTime >= readyAt;
+}
+
+void Cc1101Emulator::resetPins(void)
+{
+}
+
+void Cc1101Emulator::attachGdo(Gdo &g, void (*isr)(void *), void *arg, int mode)
+{
+  g.isr = isr;
+  g.arg = arg;
+  g.mode = mode;
+  g.level = gdoOutput(regs[g.iocfg]); // edges while detached are lost
+}
+
+void Cc1101Emulator::attachGdo0(void (*isr)(void *), void *arg, int mode)
+{
+  attachGdo(gdo[0], isr, arg, mode);
+}
+
+void Cc1101Emulator::detachGdo0(void)
+{
+  gdo[0].isr = nullptr;
+}
+
+bool Cc1101Emulator::attachGdo2(void (*isr)(void *), void *arg, int mode)
+{
+  if (!gdo2Connected)
+  {
+    return false;
+  }
+
+  attachGdo(gdo[1], isr, arg, mode);
+  return true;
+}
+
+void Cc1101Emulator::detachGdo2(void)
+{
+  gdo[1].isr = nullptr;
+}
+
+// one SPI byte: header byte (strobe or register access), then data bytes
+uint8_t Cc1101Emulator::transfer(uint8_t value)
+{
+  uint8_t result = statusByte();
+
+  stats.spiBytes++;
+  spend(spiByteTime);
+
+  if (!headerDone)
+  {
+    header = value;
+    addr = value & 0x3F;
+    headerDone = true;
+
+    if (addr >= CC1101_SRES && addr <= CC1101_SNOP && !(value & WRITE_BURST))
+    {
+      strobe(addr);
+      headerDone = false;
+    }
+  }
+  else
+  {
+    // status registers are single access, the burst bit only selects them
+    bool burst = (header & WRITE_BURST) && (addr < CC1101_PARTNUM || addr > CC1101_RCCTRL0_STATUS);
+
+    if (header & READ_SINGLE)
+    {
+      result = readRegister(addr, header & WRITE_BURST);
+    }
+    else
+    {
+      writeRegister(addr, value);
+    }
+
+    if (!burst)
+    {
+      headerDone = false; // single access, next byte is a header again
+    }
+    else if (addr < CC1101_PARTNUM - 1)
+    {
+      addr++; // burst access to config registers auto increments
+    }
+  }
+
+  updateGdo();
+  return result;
+}
+
+// chip status byte: CHIP_RDYn, STATE, FIFO_BYTES_AVAILABLE
+uint8_t Cc1101Emulator::statusByte(void)
+{
+  uint8_t s;
+
+  switch (marcState)
+  {
+    case MARCSTATE_IDLE:
+    case MARCSTATE_SLEEP:
+      s = 0;
+      break;
+    case MARCSTATE_RX:
+      s = 1;
+      break;
+    case MARCSTATE_FSTXON:
+      s = 3;
+      break;
+    case MARCSTATE_RXFIFO_OVERFLOW:
+      s = 6;
+      break;
+    case MARCSTATE_FS_LOCK:
+      s = 5;
+      break;
+    default:
+      s = 4; // calibrating
+      break;
+  }
+
+  return (hostTime < readyAt ? 0x80 : 0x00) | (s << 4) | (fifoCount > 15 ? 15 : fifoCount);
+}
+
+// RSSI is updated in RX only, otherwise it holds the last value
+uint8_t Cc1101Emulator::rssiRaw(void)
+{
+  int16_t dbm = rssiHeld;
+
+  if (marcState == MARCSTATE_RX)
+  {
+    dbm = inPacket ? packetRssi : noiseRssi;
+  }
+  return (uint8_t)((dbm + 74) * 2);
+}
+
+uint8_t Cc1101Emulator::readRegister(uint8_t a, bool burst)
+{
+  if (a == CC1101_RXFIFO)
+  {
+    return popFifo();
+  }
+
+  if (a < CC1101_PARTNUM || !burst)
+  {
+    return regs[a < CC1101_PARTNUM ? a : 0x2F];
+  }
+
+  switch (a)
+  {
+    case CC1101_PARTNUM:
+      return 0x00;
+    case CC1101_VERSION:
+      return 0x14;
+    case CC1101_LQI:
+      return 0x80 | 0x10;
+    case CC1101_RSSI:
+      return rssiRaw();
+    case CC1101_FREQEST:
+      return (uint8_t)freqEst;
+    case CC1101_MARCSTATE:
+      return marcState;
+    case CC1101_PKTSTATUS:
+      return (inPacket ? 0x08 : 0x00) | (gdoOutput(regs[CC1101_IOCFG2]) ? 0x04 : 0x00) |
+             (gdoOutput(regs[CC1101_IOCFG0]) ? 0x01 : 0x00);
+    case CC1101_RXBYTES:
+      return (overflow ? 0x80 : 0x00) | fifoCount;
+    default:
+      return 0x00;
+  }
+}
+
+void Cc1101Emulator::writeRegister(uint8_t a, uint8_t value)
+{
+  if (a < CC1101_PARTNUM - 1)
+  {
+    regs[a] = value;
+  }
+  // status registers, PATABLE and TX FIFO are not modelled
+}
+
+void Cc1101Emulator::enterTimed(uint8_t state, uint32_t duration, uint8_t after)
+{
+  marcState = state;
+  stateUntil = hostTime + duration;
+  nextState = after;
+  timed = true;
+}
+
+void Cc1101Emulator::strobe(uint8_t cmd)
+{
+  stats.strobes++;
+
+  switch (cmd)
+  {
+    case CC1101_SRES:
+      resetChip();
+      readyAt = hostTime + RESET_TIME;
+      break;
+
+    case CC1101_SCAL:
+      if (marcState == MARCSTATE_IDLE)
+      {
+        enterTimed(MARCSTATE_MANCAL, CAL_TIME, MARCSTATE_IDLE);
+        calibrate();
+      }
+      break;
+
+    case CC1101_SRX:
+      if (marcState == MARCSTATE_IDLE)
+      {
+        // MCSM0.FS_AUTOCAL = 1: calibrate when going from IDLE to RX
+        if (((regs[CC1101_MCSM0] >> 4) & 0x03) == 1)
+        {
+          enterTimed(MARCSTATE_STARTCAL, CAL_TIME + SETTLE_TIME, MARCSTATE_RX);
+          calibrate();
+        }
+        else
+          enterTimed(MARCSTATE_FS_LOCK, SETTLE_TIME, MARCSTATE_RX);
+      }
+      break;
+
+    case CC1101_SIDLE:
+      marcState = MARCSTATE_IDLE;
+      timed = false;
+      inPacket = false;
+      break;
+
+    case CC1101_SFRX:
+      if (marcState == MARCSTATE_IDLE || marcState == MARCSTATE_RXFIFO_OVERFLOW)
+      {
+        fifoHead = 0;
+        fifoCount = 0;
+        overflow = false;
+        packetEnded = false;
+        marcState = MARCSTATE_IDLE;
+      }
+      break;
+
+    case CC1101_SPWD:
+      if (marcState == MARCSTATE_IDLE)
+      {
+        powerDown = true;
+      }
+      break;
+
+    default:
+      break; // SNOP, TX related strobes and WOR are not modelled
+  }
+}
+
+// the results go to FSCAL3..1, FSCAL1 holds FSCTRL0 of the calibration here
+void Cc1101Emulator::calibrate(void)
+{
+  regs[CC1101_FSCAL3] = CAL_FSCAL3;
+  regs[CC1101_FSCAL1] = regs[CC1101_FSCTRL0];
+  drift = 0;
+}
+
+// FSCTRL0 the synthesizer was calibrated for, off by the drift since
+int8_t Cc1101Emulator::synthOffset(void)
+{
+  return (int8_t)regs[CC1101_FSCAL1] + drift;
+}
+
+// the synthesizer only locks with the results of a calibration in FSCAL3..1
+bool Cc1101Emulator::calibrated(void)
+{
+  return regs[CC1101_FSCAL3] == CAL_FSCAL3;
+}
+
+void Cc1101Emulator::dropOut(void)
+{
+  marcState = MARCSTATE_IDLE;
+  timed = false;
+  inPacket = false;
+}
+
+void Cc1101Emulator::stall(void)
+{
+  marcState = MARCSTATE_FS_LOCK;
+  timed = false;
+  inPacket = false;
+}
+
+void Cc1101Emulator::jam(void)
+{
+  while (!overflow)
+  {
+    pushFifo(0x55);
+  }
+}
+
+void Cc1101Emulator::pushFifo(uint8_t value)
+{
+  if (fifoCount == sizeof(fifo))
+  {
+    // datasheet: chip stops receiving and waits for SFRX
+    overflow = true;
+    marcState = MARCSTATE_RXFIFO_OVERFLOW;
+    inPacket = false;
+    rssiHeld = packetRssi;
+    stats.overflows++;
+    return;
+  }
+
+  fifo[(fifoHead + fifoCount) % sizeof(fifo)] = value;
+  fifoCount++;
+}
+
+uint8_t Cc1101Emulator::popFifo(void)
+{
+  if (fifoCount == 0)
+  {
+    return 0x00; // underflow, the real chip returns garbage
+  }
+
+  uint8_t value = fifo[fifoHead];
+  fifoHead = (fifoHead + 1) % sizeof(fifo);
+  fifoCount--;
+  return value;
+}
+
+void Cc1101Emulator::inject(uint64_t at, const uint8_t *data, uint16_t len, int16_t rssi,
+                            int8_t freqOffset, uint8_t dataRate)
+{
+  Telegram tg;
+  tg.at = at;
+  tg.data.assign(data, data + len);
+  tg.rssi = rssi;
+  tg.freqOffset = freqOffset;
+  tg.dataRate = dataRate;
+  tg.noise = false;
+  schedule(tg);
+  stats.injected++;
+}
+
+// keep the schedule ordered
+void Cc1101Emulator::schedule(const Telegram &tg)
+{
+  size_t i = air.size();
+  while (i > airPos && air[i - 1].at > tg.at) i--;
+  air.insert(air.begin() + i, tg);
+}
+
+void Cc1101Emulator::injectNoise(uint64_t at, int16_t rssi)
+{
+  Telegram tg;
+  tg.at = at;
+  tg.rssi = rssi;
+  tg.freqOffset = 0;
+  tg.dataRate = 0;
+  tg.noise = true;
+  for (uint8_t i = 0; i < 64; i++)
+  {
+    noise = (noise >> 1) ^ (-(noise & 1) & 0xB400);
+    tg.data.push_back(noise);
+  }
+  schedule(tg);
+}
+
+// a telegram's preamble gives any PQT, noise reaches a preamble quality
+// of 0..11; carrier sense needs the RSSI above the absolute and the
+// relative threshold, those enabled
+bool Cc1101Emulator::passesGate(const Telegram &tg)
+{
+  static const int16_t relative[4] = { 0, 6, 10, 14 };
+  uint8_t pqt = regs[CC1101_PKTCTRL1] >> 5;
+  int8_t absThr = (int8_t)(regs[CC1101_AGCCTRL1] << 4) >> 4;
+  uint8_t relThr = (regs[CC1101_AGCCTRL1] >> 4) & 0x03;
+
+  if (tg.noise && pqt)
+  {
+    noise = (noise >> 1) ^ (-(noise & 1) & 0xB400);
+    if (noise % 12 < 4 * pqt) return false;
+  }
+
+  if ((regs[CC1101_MDMCFG2] & 0x07) >= 5)
+  {
+    if (absThr != -8 && tg.rssi < CS_LEVEL + absThr) return false;
+    if (relThr && tg.rssi < noiseRssi + relative[relThr]) return false;
+  }
+
+  return true;
+}
+
+// sync word detected, the telegram bytes follow at the data rate
+void Cc1101Emulator::startPacket(const Telegram &tg, uint64_t t)
+{
+  int16_t residual = residualOffset(tg);
+
+  packet = tg.data;
+  packetRssi = tg.rssi;
+  freqEst = tg.freqOffset - synthOffset();
+
+  // off frequency: the further off, the more telegrams get a bit error
+  noise = (noise >> 1) ^ (-(noise & 1) & 0xB400);
+  if (residual > FREQ_CLEAN && packet.size() > 3 && noise % (FREQ_LOCK - FREQ_CLEAN) < residual - FREQ_CLEAN)
+  {
+    packet[3 + noise % (packet.size() - 3)] ^= 0x10; // after the L-field
+    stats.corrupted++;
+  }
+  packetPos = 0;
+  nextByte = t + byteTime;
+  inPacket = true;
+  packetEnded = false;
+  stats.received++;
+}
+
+void Cc1101Emulator::receiveByte(void)
+{
+  uint8_t value;
+
+  if (packetPos < packet.size())
+  {
+    value = packet[packetPos];
+  }
+  else
+  {
+    // end of the telegram, the demodulator keeps delivering noise
+    noise = (noise >> 1) ^ (-(noise & 1) & 0xB400);
+    value = noise;
+  }
+
+  pushFifo(value);
+  if (!inPacket)
+  {
+    return; // overflow
+  }
+
+  if (packetPos == 0)
+  {
+    lengthByte = value;
+  }
+  packetPos++;
+  nextByte += byteTime;
+
+  // the length registers are evaluated live, the driver may change them
+  // while the packet is arriving
+  uint16_t pktLen = 0;
+  switch (regs[CC1101_PKTCTRL0] & 0x03)
+  {
+    case 0: // fixed length, PKTLEN = 0 means 256
+      pktLen = regs[CC1101_PKTLEN] ? regs[CC1101_PKTLEN] : 256;
+      break;
+    case 1: // variable length, first byte is the length
+      pktLen = 1 + lengthByte;
+      break;
+    default: // infinite
+      break;
+  }
+
+  if (pktLen && packetPos >= pktLen)
+  {
+    endPacket();
+  }
+}
+
+void Cc1101Emulator::endPacket(void)
+{
+  inPacket = false;
+  rssiHeld = packetRssi;
+  packetEnded = true;
+
+  // PKTCTRL1.APPEND_STATUS
+  if (regs[CC1101_PKTCTRL1] & 0x04)
+  {
+    pushFifo((uint8_t)((packetRssi + 74) * 2));
+    pushFifo(0x80 | 0x10); // CRC_OK, LQI
+  }
+
+  if (marcState == MARCSTATE_RXFIFO_OVERFLOW)
+  {
+    return;
+  }
+
+  // MCSM1.RXOFF_MODE
+  switch ((regs[CC1101_MCSM1] >> 2) & 0x03)
+  {
+    case 3:
+      marcState = MARCSTATE_RX; // search for the next sync word
+      break;
+    case 1:
+      marcState = MARCSTATE_FSTXON;
+      break;
+    default:
+      marcState = MARCSTATE_IDLE;
+      break;
+  }
+}
+
+// GDOx output for the given IOCFGx value
+bool Cc1101Emulator::gdoOutput(uint8_t cfg)
+{
+  bool level;
+  uint8_t threshold = 4 * ((regs[CC1101_FIFOTHR] & 0x0F) + 1);
+
+  switch (cfg & 0x3F)
+  {
+    case 0x00: // RX FIFO at or above threshold
+      level = fifoCount >= threshold;
+      break;
+    case 0x01: // RX FIFO at or above threshold or end of packet
+      level = fifoCount >= threshold || (packetEnded && fifoCount > 0);
+      break;
+    case 0x06: // sync word received until end of packet
+      level = inPacket;
+      break;
+    case 0x0E: // carrier sense
+      level = inPacket;
+      break;
+    default: // 0x2E high impedance and everything not modelled
+      level = false;
+      break;
+  }
+
+  return (cfg & 0x40) ? !level : level;
+}
+
+// fire the ISRs on the configured edges of GDO0 and GDO2
+void Cc1101Emulator::updateGdo(void)
+{
+  for (Gdo &g : gdo)
+  {
+    bool level = gdoOutput(regs[g.iocfg]);
+
+    if (level == g.level)
+    {
+      continue;
+    }
+    g.level = level;
+
+    if (g.isr && ((level && g.mode == RISING) || (!level && g.mode == FALLING)))
+    {
+      g.isr(g.arg);
+    }
+  }
+}
+
+uint64_t Cc1101Emulator::nextEvent(void)
+{
+  uint64_t next = UINT64_MAX;
+
+  if (timed && stateUntil < next) next = stateUntil;
+  if (inPacket && nextByte < next) next = nextByte;
+  if (airPos < air.size() && air[airPos].at < next) next = air[airPos].at;
+
+  return next;
+}
+
+// run everything inside the chip up to time t, in time order
+// the clock is set back to each event, so ISRs see the time of the edge
+void Cc1101Emulator::process(uint64_t t)
+{
+  uint64_t now = hostTime;
+
+  for (;;)
+  {
+    uint64_t next = nextEvent();
+    if (next > t)
+    {
+      break;
+    }
+    hostTime = next;
+
+    if (timed && stateUntil == next)
+    {
+      timed = false;
+      marcState = nextState;
+    }
+    else if (inPacket && nextByte == next)
+    {
+      receiveByte();
+    }
+    else
+    {
+      const Telegram &tg = air[airPos++];
+
+      if (marcState != MARCSTATE_RX || inPacket)
+        stats.missed++; // not searching for a sync word
+      else if (tg.dataRate && tg.dataRate != regs[CC1101_MDMCFG3])
+        stats.otherMode++;
+      else if (!calibrated() || residualOffset(tg) > FREQ_LOCK)
+        stats.offFrequency++;
+      else if (!passesGate(tg))
+        stats.gated++;
+      else
+        startPacket(tg, tg.at);
+    }
+
+    updateGdo();
+  }
+
+  hostTime = now;
+}
+
+void Cc1101Emulator::update(void)
+{
+  process(hostTime);
+}
@@ -0,0 +1,176 @@
+#ifndef __CC1101EMULATOR_H__
+#define __CC1101EMULATOR_H__
+
+#include <Arduino.h>
+#include <vector>
+#include "Cc1101Bus.h"
+
+// register level model of a CC1101 behind a Cc1101Bus, for the host build
+// models: config/status registers, SPI header decoding incl. burst access,
+// command strobes, MARCSTATE transitions with calibration times, the 64 byte
+// RX FIFO incl. overflow, infinite/fixed packet length, MCSM1 RXOFF_MODE
+// and GDO0/GDO2 edges (IOCFGx 0x00, 0x01, 0x06)
+// a telegram's frequency offset shows up in FREQEST relative to FSCTRL0 as of
+// the last calibration, the further off, the more telegrams are corrupted
+// and beyond the lock range their sync word isn't found at all
+// the synthesizer needs calibration results in FSCAL3..1, from SCAL, auto
+// calibration or written back by the driver, a reset loses them
+// telegrams of another mode (data rate) than configured aren't received
+// sync word hits in noise can be injected, PKTCTRL1.PQT and carrier sense
+// (AGCCTRL1 thresholds, MDMCFG2.SYNC_MODE 5..7) keep part of them out
+// telegrams are injected with an on-air start time and arrive in the FIFO
+// byte by byte at the configured data rate
+class Cc1101Emulator : public Cc1101Bus
+{
+  public:
+    struct Stats
+    {
+      uint32_t injected = 0; // telegrams scheduled
+      uint32_t received = 0; // telegrams whose sync word was detected
+      uint32_t missed = 0;   // telegrams on air while not searching for sync
+      uint32_t offFrequency = 0; // telegrams outside of the lock range
+      uint32_t corrupted = 0;    // telegrams with a bit error from a frequency offset
+      uint32_t otherMode = 0;    // telegrams sent with another data rate
+      uint32_t gated = 0;        // sync word hits suppressed by PQT or carrier sense
+      uint32_t overflows = 0;
+      uint32_t spiTransactions = 0;
+      uint32_t spiBytes = 0;
+      uint32_t strobes = 0;
+    };
+
+    // spiByteTime: virtual micros per SPI byte, csTime: per CS assertion
+    Cc1101Emulator(uint32_t byteTime = 78, uint32_t spiByteTime = 2, uint32_t csTime = 1);
+
+    // Cc1101Bus
+    void begin(void) override;
+    void select(void) override;
+    void deselect(void) override;
+    bool misoLow(void) override;
+    uint8_t transfer(uint8_t value) override;
+    void resetPins(void) override;
+    void attachGdo0(void (*isr)(void *), void *arg, int mode) override;
+    void detachGdo0(void) override;
+    bool attachGdo2(void (*isr)(void *), void *arg, int mode) override;
+    void detachGdo2(void) override;
+
+    bool gdo2Connected = true; // false: attachGdo2() fails like on a board without GDO2
+
+    // schedule a telegram (bytes after the sync word) at absolute time 'at'
+    // freqOffset: carrier offset of the sender in FREQEST steps (Fxosc/2^14)
+    // dataRate: MDMCFG3 the receiver needs for this telegram, 0: any
+    void inject(uint64_t at, const uint8_t *data, uint16_t len, int16_t rssi = -70,
+                int8_t freqOffset = 0, uint8_t dataRate = 0);
+
+    // the sync word shows up in noise at 'at', random bytes follow
+    void injectNoise(uint64_t at, int16_t rssi);
+
+    // brown out: registers back to reset values, IDLE, FIFO empty
+    void glitch(void) { resetChip(); }
+
+    // faults for the recovery stages
+    void dropOut(void);            // RX left for IDLE
+    void jam(void);                // RX FIFO overflow, waits for SFRX
+    void stall(void);              // stuck waiting for the synthesizer to lock
+    void detune(int8_t steps) { drift += steps; } // until the next calibration
+
+    // advance the chip to the current virtual time, fires GDO0 interrupts
+    void update(void);
+
+    // next time something happens inside the chip, UINT64_MAX if nothing
+    uint64_t nextEvent(void);
+
+    uint8_t getMarcState(void) { return marcState; }
+    uint8_t getReg(uint8_t addr) { return regs[addr & 0x3F]; }
+    const Stats &getStats(void) { return stats; }
+
+  private:
+    struct Telegram
+    {
+      uint64_t at;
+      std::vector<uint8_t> data;
+      int16_t rssi;
+      int8_t freqOffset;
+      uint8_t dataRate;
+      bool noise;         // no preamble before the sync word
+    };
+
+    const uint32_t byteTime;    // micros per byte on air
+    const uint32_t spiByteTime; // micros per SPI byte
+    const uint32_t csTime;      // micros per CS assertion
+
+    uint8_t regs[0x30];
+    uint8_t marcState;
+    bool timed = false;         // marcState ends at stateUntil
+    uint64_t stateUntil = 0;    // end of a timed state (calibration, settling)
+    uint8_t nextState = 0;      // state after stateUntil
+    uint64_t readyAt = 0;       // MISO (CHIP_RDYn) low from here on
+    bool powerDown = false;     // SPWD, SLEEP when CS goes high
+
+    uint8_t fifo[64];
+    uint8_t fifoHead = 0;
+    uint8_t fifoCount = 0;
+    bool overflow = false;
+
+    // packet in reception
+    bool inPacket = false;
+    bool packetEnded = false;   // end of packet reached, for GDO 0x01
+    std::vector<uint8_t> packet;
+    int16_t packetRssi = 0;
+    int8_t freqEst = 0;         // FREQEST of the last packet
+    int8_t drift = 0;           // synthesizer drift since the last calibration
+    uint16_t packetPos = 0;     // bytes received of the current packet
+    uint8_t lengthByte = 0;     // first byte, for variable length mode
+    uint64_t nextByte = 0;      // arrival time of the next byte
+    uint16_t noise = 0x1234;    // filler after the telegram in infinite mode
+
+    std::vector<Telegram> air;  // scheduled telegrams, ordered by time
+    size_t airPos = 0;
+
+    // SPI transaction
+    bool selected = false;
+    bool headerDone = false;
+    uint8_t header = 0;
+    uint8_t addr = 0;
+
+    // GDO0 and GDO2 interrupts
+    struct Gdo
+    {
+      uint8_t iocfg;     // configuration register
+      void (*isr)(void *);
+      void *arg;
+      int mode;
+      bool level;
+    };
+    Gdo gdo[2] = {}; // GDO0, GDO2
+
+    int16_t noiseRssi = -105;
+    int16_t rssiHeld = -105;    // RSSI outside of RX
+    Stats stats;
+
+    void resetChip(void);
+    void strobe(uint8_t cmd);
+    uint8_t readRegister(uint8_t a, bool burst);
+    void writeRegister(uint8_t a, uint8_t value);
+    uint8_t statusByte(void);
+    uint8_t rssiRaw(void);
+
+    void enterTimed(uint8_t state, uint32_t duration, uint8_t after);
+    void process(uint64_t t);
+    void calibrate(void);
+    bool calibrated(void);
+    int8_t synthOffset(void);
+    int16_t residualOffset(const Telegram &tg) { return abs(tg.freqOffset - synthOffset()); }
+    bool passesGate(const Telegram &tg);
+    void schedule(const Telegram &tg);
+    void startPacket(const Telegram &tg, uint64_t t);
+    void receiveByte(void);
+    void endPacket(void);
+    void pushFifo(uint8_t value);
+    uint8_t popFifo(void);
+    void attachGdo(Gdo &g, void (*isr)(void *), void *arg, int mode);
+    void updateGdo(void);
+    bool gdoOutput(uint8_t cfg);
+    void spend(uint32_t us);
+};
+
+#endif // __CC1101EMULATOR_H__
@@ -0,0 +1,1321 @@
+// host bench: Cc1101Radio against the emulated CC1101
+// injects synthetic C1 telegrams and reports how many made it into the
+// frame queue, with the radio's drain and blind time statistics
+//
+//   pio run -e native && .pio/build/native/program [frames] [gap_us] [recover|restart|nogdo2|afc|drift|noise|window|modes|decode3of6|diversity|watchdog|formata|formatb|registry|keycache|telegram|crc]
+//
+// recover, restart: the chip loses its configuration half way, 10 ms later
+// the radio gets recover() or restart() like on a receive timeout
+// nogdo2: GDO2 not connected, sync word times are estimated
+// afc: the meter is off frequency, FreqTracker corrects it from good frames
+// drift: the synthesizer drifts half way, build with RX_FSCAL_CACHE and
+// the CRC error trend asks for a new calibration, nothing else would
+// noise: 4 sync word hits in noise per telegram, at random times just above
+// the noise floor, build with RX_PQT / RX_CS_REL / RX_CS_ABS to gate them
+// window: one telegram every 16 s with some jitter, one of them lost,
+// RxScheduler powers the radio down between the expected telegrams
+// modes: a C1 meter every 16 s and T1 meters every 8 s and 30 s, the
+// ModeScheduler switches the profile, 'frames' C1 telegrams are sent
+// decode3of6: throughput of the 3-out-of-6 decoders, 'frames' frames each
+// diversity: two emulated radios, each loses some telegrams, FrameMerger
+// passes every telegram heard on once, the copy with the better RSSI
+// watchdog: faults for each recovery stage, counters and recovery times
+// formata: C1 telegrams in frame format A, every 5th with a corrupt block
+// formatb: encrypted format B telegrams up to L = 255, two CRC blocks for
+// L > 127, checked while draining, then decrypted in place and parsed
+// registry: 'frames' meters registered, lookups of known and unknown IDs
+// keycache: 'frames' frames decrypted with 1, 50 and 500 meters registered
+// telegram: Multical21 frames decrypted in place and parsed with TelegramView
+// crc: EN 13757 CRC of real telegrams, bit by bit and table driven
+
+#include <Arduino.h>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <vector>
+#include "Cc1101Radio.h"
+#include "Cc1101Emulator.h"
+#include "FreqTracker.h"
+#include "RxScheduler.h"
+#include "ModeScheduler.h"
+#include "FrameMerger.h"
+#include "MeterRegistry.h"
+#include "TelegramView.h"
+
+// format B frame at 'p' (L-field) with a valid CRC, a frame with L > 127
+// has a second block after the CRC of the first 126 bytes
+static bool formatBValid(const uint8_t *p)
+{
+  uint16_t end = p[0] - 1; // the last CRC
+
+  if (p[0] > WMBUS_B_BLOCK + 1)
+  {
+    if (crcEN13575(p, WMBUS_B_BLOCK) != (p[WMBUS_B_BLOCK] << 8 | p[WMBUS_B_BLOCK + 1])) return false;
+    return crcEN13575(&p[WMBUS_B_BLOCK + 2], end - WMBUS_B_BLOCK - 2) == (p[end] << 8 | p[end + 1]);
+  }
+  return crcEN13575(p, end) == (p[end] << 8 | p[end + 1]);
+}
+
+// preamble bytes + L-field + payload + CRC, CRC over L-field and payload,
+// with L > 127 one more after the first 126 bytes
+// the sequence number is in the first two payload bytes
+static uint16_t makeTelegram(uint8_t *buf, uint8_t len, uint32_t seq)
+{
+  buf[0] = 0x54;
+  buf[1] = 0x3D;
+  buf[2] = len;
+  buf[3] = seq & 0xFF;
+  buf[4] = seq >> 8;
+  for (uint16_t i = 5; i < len + 1u; i++)
+  {
+    buf[i] = (uint8_t)(seq * 31 + i * 7);
+  }
+
+  uint8_t *block = &buf[2];
+  uint16_t crc;
+  if (len > WMBUS_B_BLOCK + 1)
+  {
+    crc = crcEN13575(block, WMBUS_B_BLOCK);
+    block[WMBUS_B_BLOCK] = crc >> 8;
+    block[WMBUS_B_BLOCK + 1] = crc & 0xFF;
+    block += WMBUS_B_BLOCK + 2;
+  }
+  crc = crcEN13575(block, &buf[len + 1] - block);
+  buf[len + 1] = crc >> 8;
+  buf[len + 2] = crc & 0xFF;
+
+  return len + 3;
+}
+
+// C1 telegram of meter 'id', A-field in payload[4..7], extended link
+// layer (CI 0x8D) with the access number 'seq'
+static uint16_t makeC1(uint8_t *buf, uint32_t id, uint32_t seq)
+{
+  makeTelegram(buf, 44, seq);
+  memcpy(&buf[6], &id, 4);
+  buf[12] = 0x8D;
+  buf[13] = 0x20;
+  buf[14] = seq & 0xFF;
+
+  uint16_t crc = crcEN13575(&buf[2], 43);
+  buf[45] = crc >> 8;
+  buf[46] = crc & 0xFF;
+  return 47;
+}
+
+// 3-out-of-6 codes of the nibbles 0..F
+static const uint8_t codes[16] =
+{
+  0x16, 0x0D, 0x0E, 0x0B, 0x1C, 0x19, 0x1A, 0x13,
+  0x2C, 0x25, 0x26, 0x23, 0x34, 0x31, 0x32, 0x29
+};
+
+// codes 'len' bytes, returns the coded length
+static uint16_t encode3of6(const uint8_t *in, uint16_t len, uint8_t *out)
+{
+  uint32_t bits = 0;
+  uint8_t nbits = 0;
+  uint16_t n = 0;
+
+  for (uint16_t i = 0; i < len; i++)
+  {
+    bits = bits << 12 | codes[in[i] >> 4] << 6 | codes[in[i] & 0x0F];
+    nbits += 12;
+    while (nbits >= 8)
+    {
+      out[n++] = bits >> (nbits - 8);
+      nbits -= 8;
+    }
+  }
+  if (nbits) out[n++] = bits << (8 - nbits);
+  return n;
+}
+
+// T1 telegram of meter 'id': format A with two blocks, 3-out-of-6 coded
+static uint16_t makeT1(uint8_t *buf, uint32_t id, uint32_t seq)
+{
+  uint8_t frame[29]; // L = 24: 10 + CRC + 15 + CRC
+  uint16_t crc;
+
+  frame[0] = 24;
+  frame[1] = 0x44;
+  frame[2] = 0x2D;
+  frame[3] = 0x2C;
+  memcpy(&frame[4], &id, 4);
+  frame[8] = 0x1B;
+  frame[9] = 0x16;
+  crc = crcEN13575(frame, 10);
+  frame[10] = crc >> 8;
+  frame[11] = crc & 0xFF;
+  for (uint8_t i = 12; i < 27; i++) frame[i] = (uint8_t)(seq * 13 + i);
+  crc = crcEN13575(&frame[12], 15);
+  frame[27] = crc >> 8;
+  frame[28] = crc & 0xFF;
+
+  return encode3of6(frame, sizeof(frame), buf);
+}
+
+// reference: bit by bit, each code looked up in the code table
+static bool naiveDecode3of6(const uint8_t *in, uint8_t *out, uint16_t len)
+{
+  uint32_t bit = 0;
+
+  for (uint16_t i = 0; i < len; i++)
+  {
+    uint8_t nibble[2];
+    for (uint8_t k = 0; k < 2; k++)
+    {
+      uint8_t code = 0;
+      for (uint8_t b = 0; b < 6; b++, bit++)
+      {
+        code = code << 1 | ((in[bit / 8] >> (7 - bit % 8)) & 1);
+      }
+
+      uint8_t v = 0;
+      while (v < 16 && codes[v] != code) v++;
+      if (v == 16) return false;
+      nibble[k] = v;
+    }
+    out[i] = nibble[0] << 4 | nibble[1];
+  }
+  return true;
+}
+
+// decoder throughput in wall time, 'frames' longest format A frames
+// (L = 255) per decoder
+static int benchDecoder(uint32_t frames)
+{
+  using Clock = std::chrono::steady_clock;
+  const uint16_t len = formatALength(255);
+  const uint16_t fifoChunk = 32;
+  std::vector<uint8_t> plain(len), coded(length3of6(len)), out(coded.size());
+  uint32_t mismatches = 0;
+
+  for (uint16_t i = 0; i < len; i++) plain[i] = (uint8_t)(i * 151 + 7);
+  encode3of6(plain.data(), len, coded.data());
+
+  auto run = [&](const char *name, auto decode)
+  {
+    Clock::time_point start = Clock::now();
+    for (uint32_t f = 0; f < frames; f++)
+    {
+      coded[0] = codes[f & 0x0F] << 2 | (coded[0] & 0x03); // defeat hoisting
+      decode();
+    }
+    double s = std::chrono::duration<double>(Clock::now() - start).count();
+
+    coded[0] = codes[plain[0] >> 4] << 2 | (coded[0] & 0x03);
+    decode();
+    if (memcmp(out.data(), plain.data(), len) != 0) mismatches++;
+
+    Serial.printf("%-22s %8.1f MB/s decoded, %6.2f us per frame\n", name,
+                  frames * (double)len / s / 1e6, s * 1e6 / frames);
+  };
+
+  Serial.printf("\n3-out-of-6 decoding, %u frames of %u coded bytes\n", frames, (uint32_t)coded.size());
+
+  run("bit by bit", [&]() { naiveDecode3of6(coded.data(), out.data(), len); });
+  run("table, one shot", [&]() { decode3of6(coded.data(), out.data(), len); });
+  run("table, 32 byte chunks", [&]()
+  {
+    Decoder3of6 decoder;
+    decoder.begin(out.data(), len);
+    for (uint16_t pos = 0; pos < coded.size(); pos += fifoChunk)
+    {
+      decoder.feed(&coded[pos], std::min<uint16_t>(fifoChunk, coded.size() - pos));
+    }
+  });
+  run("table, in place", [&]()
+  {
+    // like the radio: the chunks are decoded where they were read to
+    memcpy(out.data(), coded.data(), coded.size());
+    Decoder3of6 decoder;
+    decoder.begin(out.data(), len);
+    for (uint16_t pos = 0; pos < coded.size(); pos += fifoChunk)
+    {
+      decoder.feed(&out[pos], std::min<uint16_t>(fifoChunk, coded.size() - pos));
+    }
+  });
+
+  Serial.printf("Mismatches: %u\n", mismatches);
+  return mismatches ? 1 : 0;
+}
+
+// C1 and T1 meters received time-sliced, see ModeScheduler
+static int benchModes(uint32_t frames)
+{
+  struct Sender { uint32_t id; RadioProfile profile; uint64_t interval; uint64_t phase; uint32_t sent; uint32_t received; };
+  Sender senders[] =
+  {
+    { 0x12345678, PROFILE_C1, 16000000, 50000, 0, 0 },
+    { 0x11111111, PROFILE_T1, 8000000, 3000000, 0, 0 },
+    { 0x22222222, PROFILE_T1, 30000000, 7000000, 0, 0 },
+  };
+  uint64_t end = frames * 16000000ULL;
+  uint8_t buf[WMBUS_MAX_CODED];
+
+  Cc1101Emulator emu;
+  Cc1101Radio radio(emu);
+  ModeScheduler modes;
+
+  radio.begin();
+
+  for (Sender &s : senders)
+  {
+    for (uint64_t at = s.phase; at < end; at += s.interval)
+    {
+      // +-10 ms jitter
+      uint64_t t = at + ((s.sent * 2654435761u) >> 16) % 21 * 1000;
+      if (s.profile == PROFILE_C1)
+        emu.inject(t, buf, makeC1(buf, s.id, s.sent), -70, 0, CC1101_DEFVAL_MDMCFG3);
+      else
+        emu.inject(t, buf, makeT1(buf, s.id, s.sent), -70, 0, CC1101_T1_MDMCFG3);
+      s.sent++;
+    }
+  }
+
+  while (hostTime < end + 100000)
+  {
+    emu.update();
+    radio.setProfile(modes.select(micros()));
+    radio.tick();
+
+    RawFrame *frame;
+    while ((frame = radio.frames().front()) != nullptr)
+    {
+      uint32_t id = 0;
+
+      if (frame->profile == PROFILE_T1)
+      {
+        // decoded and its block CRCs checked by the radio
+        memcpy(&id, &frame->data[4], 4);
+      }
+      else
+      {
+        uint8_t *payload = &frame->data[2];
+        uint8_t length = payload[0];
+        if (crcEN13575(payload, length - 1) == (payload[length - 1] << 8 | payload[length]))
+          memcpy(&id, &payload[4], 4);
+      }
+
+      for (Sender &s : senders)
+      {
+        if (id && s.id == id && s.profile == frame->profile)
+        {
+          s.received++;
+          modes.frame(id, (RadioProfile)frame->profile, frame->syncTime);
+        }
+      }
+      radio.frames().pop();
+    }
+
+    delayMicroseconds(50);
+  }
+
+  char json[256];
+  modes.toJson(json, sizeof(json));
+
+  Serial.printf("\n%u s of C1 and T1 meters\n", (uint32_t)(end / 1000000));
+  for (Sender &s : senders)
+  {
+    Serial.printf("%08x %s every %u s - sent: %u, received: %u\n", s.id,
+                  Cc1101Radio::profileName(s.profile), (uint32_t)(s.interval / 1000000), s.sent, s.received);
+  }
+  Serial.printf("Modes %s\n", json);
+  Serial.printf("Emulator - other mode: %u, missed: %u\n", emu.getStats().otherMode, emu.getStats().missed);
+
+  return 0;
+}
+
+// C1 telegram in frame format A: preamble 0x54 0xCD, a CRC after the
+// first 10 bytes and after every 16 byte block, 'plain' gets the frame
+// without the CRCs. With 'corrupt' a byte of the second block is wrong.
+static uint16_t makeC1A(uint8_t *buf, uint8_t *plain, uint8_t len, uint32_t seq, bool corrupt)
+{
+  uint16_t n = 2, block = 10;
+
+  plain[0] = len;
+  plain[1] = seq & 0xFF;
+  plain[2] = seq >> 8;
+  for (uint16_t i = 3; i < len + 1u; i++)
+  {
+    plain[i] = (uint8_t)(seq * 31 + i * 7);
+  }
+
+  buf[0] = 0x54;
+  buf[1] = 0xCD;
+  for (uint16_t i = 0; i < len + 1u; i += block, block = 16)
+  {
+    uint16_t k = len + 1u - i < block ? len + 1u - i : block;
+    uint16_t crc = crcEN13575(&plain[i], k);
+    memcpy(&buf[n], &plain[i], k);
+    n += k;
+    buf[n++] = crc >> 8;
+    buf[n++] = crc & 0xFF;
+  }
+
+  if (corrupt) buf[2 + 12 + 5] ^= 0x10;
+  return n;
+}
+
+// format A: the block CRCs are checked while the frame is drained, a
+// corrupt one is dropped after its bad block, the others arrive without
+// their CRCs
+static int benchFormatA(uint32_t frames, uint32_t gap)
+{
+  std::vector<std::vector<uint8_t>> plain(frames, std::vector<uint8_t>(256));
+  uint8_t buf[2 + WMBUS_MAX_LENGTH];
+  uint32_t received = 0, mismatches = 0, corrupt = 0, corruptBytes = 0;
+
+  Cc1101Emulator emu;
+  Cc1101Radio radio(emu);
+
+  radio.begin();
+
+  uint64_t at = 50000;
+  for (uint32_t i = 0; i < frames; i++)
+  {
+    bool bad = i % 5 == 4;
+    uint16_t n = makeC1A(buf, plain[i].data(), (i % 4 == 3) ? 120 : 44, i, bad);
+    emu.inject(at, buf, n, -60);
+    if (bad)
+    {
+      corrupt++;
+      corruptBytes += n;
+    }
+    at += (uint64_t)n * 78 + gap;
+  }
+
+  while (hostTime < at + 100000)
+  {
+    emu.update();
+    radio.tick();
+
+    RawFrame *frame;
+    while ((frame = radio.frames().front()) != nullptr)
+    {
+      uint8_t *p = &frame->data[2];
+      uint32_t seq = p[1] | p[2] << 8;
+
+      received++;
+      if (!frame->formatA || seq >= frames || frame->length != 3 + p[0] ||
+          memcmp(p, plain[seq].data(), p[0] + 1) != 0)
+      {
+        mismatches++;
+      }
+      radio.frames().pop();
+    }
+
+    delayMicroseconds(50);
+  }
+
+  const WakeupStats &w = radio.getWakeupStats();
+  uint32_t dropped = w.count[WAKEUP_BLOCK_CRC];
+
+  Serial.printf("\nFormat A, %u telegrams, %u with a corrupt second block\n", frames, corrupt);
+  Serial.printf("received: %u, mismatches: %u, missed by receiver: %u\n",
+                received, mismatches, emu.getStats().missed);
+  Serial.printf("block CRC drops: %u, drained: %u bytes per frame of %u on air, %u us\n",
+                dropped, w.noiseBytes / (dropped ? dropped : 1), corruptBytes / (corrupt ? corrupt : 1),
+                w.noiseTime / (dropped ? dropped : 1));
+
+  return mismatches == 0 && dropped == corrupt ? 0 : 1;
+}
+
+// two receivers with their own antenna: each one loses about a third of
+// the telegrams and hears them with another RSSI, FrameMerger passes
+// every telegram on once, the copy with the better RSSI
+static int benchDiversity(uint32_t frames, uint32_t gap)
+{
+  const uint8_t radios = 2;
+  const uint32_t meters[] = { 0x12345678, 0x87654321 };
+  struct Expected { int8_t best; int16_t rssi[radios]; bool passed; };
+  std::vector<Expected> expected(frames);
+  uint32_t onlyOne = 0, both = 0, none = 0;
+  uint32_t passed = 0, repeated = 0, worse = 0, unknown = 0;
+  uint32_t seed = 0x2545F491;
+  uint8_t buf[WMBUS_MAX_CODED];
+
+  Cc1101Emulator emu[radios];
+  Cc1101Radio radio[radios] = { emu[0], emu[1] };
+  FrameMerger merger;
+
+  for (uint8_t r = 0; r < radios; r++)
+  {
+    merger.add(radio[r].frames());
+    radio[r].begin();
+  }
+
+  uint64_t start = 100000;
+  for (uint32_t i = 0; i < frames; i++)
+  {
+    Expected &e = expected[i];
+    uint64_t at = start + i * (47 * 78ULL + gap);
+    uint16_t len = makeC1(buf, meters[i % 2], i);
+
+    e.best = -1;
+    e.passed = false;
+    for (uint8_t r = 0; r < radios; r++)
+    {
+      seed ^= seed << 13; // xorshift32
+      seed ^= seed >> 17;
+      seed ^= seed << 5;
+      e.rssi[r] = seed % 3 == 0 ? 0 : -95 + (int16_t)((seed >> 8) % 30); // 0: faded out
+      if (e.rssi[r] == 0) continue;
+
+      // same sync word time at both receivers
+      emu[r].inject(at, buf, len, e.rssi[r]);
+      if (e.best < 0 || e.rssi[r] > e.rssi[e.best]) e.best = r;
+    }
+
+    bool a = e.rssi[0] != 0, b = e.rssi[1] != 0;
+    if (a && b) both++;
+    else if (a || b) onlyOne++;
+    else none++;
+  }
+
+  uint64_t end = start + frames * (47 * 78ULL + gap) + 100000;
+  while (hostTime < end)
+  {
+    for (uint8_t r = 0; r < radios; r++)
+    {
+      emu[r].update();
+      radio[r].tick();
+    }
+
+    RawFrame *frame;
+    while ((frame = merger.front(micros())) != nullptr)
+    {
+      uint32_t seq = frame->data[3] | frame->data[4] << 8;
+
+      if (seq >= frames)
+        unknown++;
+      else if (expected[seq].passed)
+        repeated++;
+      else
+      {
+        expected[seq].passed = true;
+        passed++;
+        // RSSI is reported in 0.5 dB steps
+        if (expected[seq].best != frame->radio && expected[seq].rssi[frame->radio] < expected[seq].rssi[expected[seq].best] - 1)
+          worse++;
+      }
+      merger.pop();
+    }
+
+    delayMicroseconds(50);
+  }
+
+  char json[256];
+  merger.toJson(json, sizeof(json));
+
+  Serial.printf("\n%u telegrams, heard by both: %u, by one: %u, by none: %u\n", frames, both, onlyOne, none);
+  for (uint8_t r = 0; r < radios; r++)
+  {
+    const MergeStats &m = merger.getStats(r);
+    Serial.printf("Radio %d - frames: %u (%u%%), emulator missed: %u\n", r, m.frames,
+                  m.frames * 100 / frames, emu[r].getStats().missed);
+  }
+  Serial.printf("Merged - passed: %u (%u%%), repeated: %u, not the best copy: %u, unknown: %u\n",
+                passed, passed * 100 / frames, repeated, worse, unknown);
+  Serial.printf("Diversity %s\n", json);
+
+  return passed == both + onlyOne && repeated == 0 && worse == 0 ? 0 : 1;
+}
+
+// recovery stages: a fault every 10 s, the watchdog checks the radio
+// 1 ms later (like a receive timeout), the detuned synthesizer isn't a
+// symptom the check sees, its recovery is requested as RECOVER_RX twice
+// and escalated; quiet time at the end, health checks must not recover
+static int benchWatchdog(void)
+{
+  const uint64_t gap = 500000;     // micros between telegrams
+  const uint64_t quiet = 60000000; // no telegrams from here on
+  const uint64_t end = 90000000;
+  const char *faults[] = { "drop out", "jam", "glitch", "detune", "stall" };
+  uint8_t buf[64];
+  uint32_t sent = 0, received = 0, falseRecoveries = 0;
+
+  Cc1101Emulator emu;
+  Cc1101Radio radio(emu);
+
+  radio.begin();
+  for (uint64_t at = 200000; at < quiet; at += gap)
+  {
+    emu.inject(at, buf, makeC1(buf, 0x12345678, sent), -70);
+    sent++;
+  }
+
+  uint64_t nextFault = 10000000, check = 0, request = 0;
+  uint8_t fault = 0, requests = 0;
+  while (hostTime < end)
+  {
+    emu.update();
+    radio.tick();
+
+    if (fault < 5 && hostTime >= nextFault)
+    {
+      Serial.printf("\n%u ms: %s\n", (uint32_t)(hostTime / 1000), faults[fault]);
+      switch (fault)
+      {
+        case 0: emu.dropOut(); break;
+        case 1: emu.jam(); break;
+        case 2: emu.glitch(); break;
+        case 3: emu.detune(40); request = hostTime + 1000; requests = RX_FSCAL_CACHE ? 3 : 2; break;
+        default: emu.stall(); break;
+      }
+      if (fault != 3) check = hostTime + 1000;
+      fault++;
+      nextFault += 10000000;
+    }
+
+    if (check && hostTime >= check)
+    {
+      radio.checkHealth();
+      check = 0;
+    }
+
+    // detuned: frames missed, the first request isn't enough, with the
+    // cached calibration only the calibrate stage helps
+    if (requests && hostTime >= request)
+    {
+      radio.recover(RECOVER_RX);
+      request = hostTime + 2000000;
+      requests--;
+    }
+
+    // quiet night: receive timeouts, nothing is wrong with the radio
+    if (hostTime > quiet && hostTime % 5000000 < 50)
+    {
+      uint32_t before = 0;
+      for (uint8_t i = 0; i < RECOVER_STAGES; i++) before += radio.getRecoveryStats((RecoveryStage)i).count;
+      radio.checkHealth();
+      for (uint8_t t = 0; t < 20; t++) { delayMicroseconds(50); emu.update(); radio.tick(); }
+      for (uint8_t i = 0; i < RECOVER_STAGES; i++) falseRecoveries += radio.getRecoveryStats((RecoveryStage)i).count;
+      falseRecoveries -= before;
+    }
+
+    RawFrame *frame;
+    while ((frame = radio.frames().front()) != nullptr)
+    {
+      received++;
+      radio.frames().pop();
+    }
+
+    delayMicroseconds(50);
+  }
+
+  char json[512];
+  radio.recoveryToJson(json, sizeof(json));
+
+  Serial.printf("\nTelegrams - sent: %u, received: %u\n", sent, received);
+  for (uint8_t i = 0; i < RECOVER_STAGES; i++)
+  {
+    const RecoveryStats &r = radio.getRecoveryStats((RecoveryStage)i);
+    Serial.printf("%-9s - count: %u, escalated: %u, back in RX after: %u us (max %u us)\n",
+                  Cc1101Radio::stageName((RecoveryStage)i), r.count, r.escalated, r.time.avg(), r.time.max);
+  }
+  Serial.printf("Quiet time - recoveries: %u\n", falseRecoveries);
+  Serial.printf("Recovery %s\n", json);
+
+  return falseRecoveries == 0 ? 0 : 1;
+}
+
+// serial number 'n' as printed on a meter, decimal digits in BCD
+static uint32_t serialNumber(uint32_t n)
+{
+  uint32_t id = 0;
+  for (uint8_t shift = 0; shift < 32; shift += 4, n /= 10)
+  {
+    id |= (n % 10) << shift;
+  }
+  return id;
+}
+
+// 'meters' meters of a building, serial numbers in a row, looked up for
+// frames of theirs and of as many meters we don't have the key of
+static int benchRegistry(uint32_t meters)
+{
+  using Clock = std::chrono::steady_clock;
+  static MeterRegistry registry; // too large for the stack with a big METER_MAX
+  const uint32_t lookups = 1000000;
+  std::vector<uint32_t> ids(2 * meters);
+  uint8_t key[16] = { 0 };
+  uint32_t found = 0;
+
+  // every other frame is from a meter of the neighbourhood
+  for (uint32_t i = 0; i < meters; i++)
+  {
+    ids[2 * i] = serialNumber(72010000 + i);
+    ids[2 * i + 1] = serialNumber(65300000 + i);
+    key[0] = i;
+    registry.add(ids[2 * i], key);
+  }
+
+  Clock::time_point start = Clock::now();
+  for (uint32_t i = 0; i < lookups; i++)
+  {
+    if (registry.find(ids[(i * 2654435761u) % ids.size()])) found++;
+  }
+  double s = std::chrono::duration<double>(Clock::now() - start).count();
+
+  Serial.printf("\nMeter registry, %u meters, %u slots, %u bytes\n", meters, registry.slots(),
+                (uint32_t)sizeof(registry));
+  Serial.printf("registered: %u of %u, longest probe sequence: %u\n",
+                registry.size(), registry.capacity(), registry.getMaxProbes());
+  Serial.printf("%u lookups, half of them unknown meters: %u found, %.1f ns per lookup\n",
+                lookups, found, s * 1e9 / lookups);
+
+  return registry.size() == std::min<uint32_t>(meters, registry.capacity()) ? 0 : 1;
+}
+
+// frames of 'meters' meters decrypted four ways: key set up per frame like
+// with one cipher object for all (small and expanded schedule), each
+// meter's own small schedule, and the registry's expanded ones for the
+// hot meters. Half of the frames are from 4 meters close to the gateway,
+// the others from all meters in turn.
+static int benchKeyCache(uint32_t frames)
+{
+  using Clock = std::chrono::steady_clock;
+  const uint32_t counts[] = { 1, 50, 500 };
+  int result = 0;
+
+  Serial.printf("\nAES key schedules, %u frames of 32 cipher bytes, %u expanded schedules\n",
+                frames, METER_HOT);
+
+  for (uint32_t meters : counts)
+  {
+    if (meters > METER_MAX)
+    {
+      Serial.printf("%u meters: build with METER_MAX >= %u\n", meters, meters);
+      continue;
+    }
+
+    std::unique_ptr<MeterRegistry> registry(new MeterRegistry);
+    std::vector<MeterEntry *> sender(frames);
+    uint8_t key[16], iv[16] = { 0 }, cipher[32], plain[32];
+
+    for (uint32_t i = 0; i < meters; i++)
+    {
+      for (uint8_t k = 0; k < 16; k++) key[k] = (uint8_t)(i * 131 + k * 7);
+      registry->add(serialNumber(72010000 + i), key);
+    }
+    for (uint32_t f = 0; f < frames; f++)
+    {
+      uint32_t i = f & 1 ? f / 2 % meters : f / 2 % (meters < 4 ? meters : 4);
+      sender[f] = registry->find(serialNumber(72010000 + i));
+    }
+    for (uint8_t k = 0; k < 32; k++) cipher[k] = (uint8_t)(k * 29);
+
+    uint32_t reference = 0;
+    auto run = [&](const char *name, auto decrypt)
+    {
+      uint32_t check = 0;
+      Clock::time_point start = Clock::now();
+      for (uint32_t f = 0; f < frames; f++)
+      {
+        iv[15] = f; // access number
+        decrypt(*sender[f]);
+        check = check * 31 + plain[0] + plain[31];
+      }
+      double s = std::chrono::duration<double>(Clock::now() - start).count();
+
+      if (reference == 0) reference = check;
+      if (check != reference) result = 1;
+      Serial.printf("  %-28s %6.2f us per frame%s\n", name, s * 1e6 / frames,
+                    check == reference ? "" : ", wrong plaintext");
+    };
+
+    Serial.printf("%u meters:\n", meters);
+
+    CTR<AESSmall128> smallPerFrame;
+    run("small, key set per frame", [&](MeterEntry &m)
+    {
+      smallPerFrame.setKey(m.key, 16);
+      smallPerFrame.setIV(iv, 16);
+      smallPerFrame.decrypt(plain, cipher, 32);
+    });
+
+    CTR<AES128> expandedPerFrame;
+    run("expanded, key set per frame", [&](MeterEntry &m)
+    {
+      expandedPerFrame.setKey(m.key, 16);
+      expandedPerFrame.setIV(iv, 16);
+      expandedPerFrame.decrypt(plain, cipher, 32);
+    });
+
+    MeterCipher ctr;
+    run("small, per meter", [&](MeterEntry &m)
+    {
+      ctr.use(&m.cipher);
+      ctr.setIV(iv, 16);
+      ctr.decrypt(plain, cipher, 32);
+    });
+
+    run("registry, hot expanded", [&](MeterEntry &m)
+    {
+      ctr.use(registry->cipher(m));
+      ctr.setIV(iv, 16);
+      ctr.decrypt(plain, cipher, 32);
+    });
+
+    const KeyCacheStats &ks = registry->getKeyStats();
+    Serial.printf("  hot: %u, cold: %u frames, key expansions: %u\n", ks.hot, ks.cold, ks.expansions);
+  }
+
+  return result;
+}
+
+// reference: the values at the offsets of a plaintext copy, like before
+// TelegramView
+static void copyParse(const uint8_t *data, MeterState &state)
+{
+  int tt = 9, tg = 13, ic = 7, ft = 17, at = 18; // compact frame
+  if (data[2] == 0x78) // long frame
+  {
+    tt = 10; tg = 16; ic = 6; ft = 22; at = 25;
+  }
+
+  state.totalWater = data[tt] + (data[tt + 1] << 8) + (data[tt + 2] << 16) + (data[tt + 3] << 24);
+  state.targetWater = data[tg] + (data[tg + 1] << 8) + (data[tg + 2] << 16) + (data[tg + 3] << 24);
+  state.flowTemp = data[ft];
+  state.ambientTemp = data[at];
+  state.infoCodes = data[ic];
+}
+
+// compact and long Multical21 frames, encrypted, then decrypted and parsed
+// by copying them twice like before, and in the frame buffer with a view
+static int benchTelegram(uint32_t frames)
+{
+  using Clock = std::chrono::steady_clock;
+  const uint8_t key[16] = { 0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77,
+                            0x88, 0x99, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF };
+  uint8_t iv[16] = { 0x2D, 0x2C, 0x78, 0x56, 0x34, 0x12, 0x1B, 0x16, 0x8D };
+  uint8_t frame[2][64], plain[64], copy[64];
+  uint32_t mismatches = 0;
+
+  CTR<AESSmall128> ctr;
+  ctr.setKey(key, 16);
+
+  // plaintext after the header, 'len' bytes, CI 0x79 compact or 0x78 long
+  uint8_t sizes[2] = { 22, 30 };
+  for (uint8_t t = 0; t < 2; t++)
+  {
+    for (uint8_t i = 0; i < sizes[t]; i++) plain[i] = (uint8_t)(i * 37 + t);
+    plain[2] = t ? 0x78 : 0x79;
+    ctr.setIV(iv, 16);
+    ctr.encrypt(frame[t], plain, sizes[t]);
+  }
+
+  double copyTime = 0, viewTime = 0;
+  for (uint32_t f = 0; f < frames; f++)
+  {
+    uint8_t t = f & 1;
+    uint8_t buf[64];
+    MeterState a, b;
+
+    // like before: cipher copied out, decrypted into a third buffer
+    memcpy(buf, frame[t], sizes[t]);
+    Clock::time_point start = Clock::now();
+    memcpy(copy, buf, sizes[t]);
+    ctr.setIV(iv, 16);
+    ctr.decrypt(plain, copy, sizes[t]);
+    copyParse(plain, a);
+    copyTime += std::chrono::duration<double>(Clock::now() - start).count();
+
+    // in place
+    start = Clock::now();
+    ctr.setIV(iv, 16);
+    ctr.decrypt(buf, buf, sizes[t]);
+    TelegramView telegram(buf, sizes[t]);
+    if (telegram.valid())
+    {
+      b.totalWater = telegram.totalWater();
+      b.targetWater = telegram.targetWater();
+      b.flowTemp = telegram.flowTemp();
+      b.ambientTemp = telegram.ambientTemp();
+      b.infoCodes = telegram.infoCodes();
+    }
+    viewTime += std::chrono::duration<double>(Clock::now() - start).count();
+
+    if (!telegram.valid() || a.totalWater != b.totalWater || a.targetWater != b.targetWater ||
+        a.flowTemp != b.flowTemp || a.ambientTemp != b.ambientTemp || a.infoCodes != b.infoCodes)
+    {
+      mismatches++;
+    }
+  }
+
+  Serial.printf("\nMultical21 frames, %u compact and long ones decrypted and parsed\n", frames);
+  Serial.printf("copies    %6.3f us per frame\n", copyTime * 1e6 / frames);
+  Serial.printf("in place  %6.3f us per frame\n", viewTime * 1e6 / frames);
+  Serial.printf("Mismatches: %u\n", mismatches);
+  return mismatches ? 1 : 0;
+}
+
+// format B telegram with L-field 'len', encrypted like a Multical21 long
+// frame from payload[17] on, a CRC after the first 126 bytes if L > 127.
+// 'plain' gets the frame as the radio delivers it (without that CRC and
+// the last one), 'clear' the decrypted data
+static uint16_t makeEncryptedB(uint8_t *buf, uint8_t *plain, uint8_t *clear, uint8_t len,
+                               uint32_t seq, CTR<AESSmall128> &ctr)
+{
+  bool twoBlocks = len > WMBUS_B_BLOCK + 1;
+  uint16_t data = len + 1 - 2 - (twoBlocks ? 2 : 0); // L-field + data
+  uint8_t iv[16] = { 0 };
+
+  plain[0] = len;
+  plain[1] = seq & 0xFF;
+  plain[2] = seq >> 8;
+  for (uint16_t i = 3; i < data; i++)
+  {
+    plain[i] = (uint8_t)(seq * 31 + i * 7);
+  }
+  for (uint16_t i = 17; i < data; i++)
+  {
+    clear[i - 17] = (uint8_t)(seq * 13 + i * 5);
+  }
+  clear[2] = 0x78; // long frame
+
+  // IV as WaterMeter takes it from the header
+  memcpy(iv, &plain[2], 8);
+  iv[8] = plain[11];
+  memcpy(&iv[9], &plain[13], 4);
+  ctr.setIV(iv, sizeof(iv));
+  ctr.encrypt(&plain[17], clear, data - 17);
+
+  uint16_t n = 2, block = twoBlocks ? WMBUS_B_BLOCK : data;
+  buf[0] = 0x54;
+  buf[1] = 0x3D;
+  for (uint16_t i = 0; i < data; i += block)
+  {
+    uint16_t k = data - i < block ? data - i : block;
+    uint16_t crc = crcEN13575(&plain[i], k);
+    memcpy(&buf[n], &plain[i], k);
+    n += k;
+    buf[n++] = crc >> 8;
+    buf[n++] = crc & 0xFF;
+  }
+  return n;
+}
+
+// format B frames up to L = 255: the radio's CRC verdict, run along while
+// draining, for one block and for two (L > 127), with a corrupt byte in
+// one of the blocks of every 4th frame. The good ones are decrypted in
+// place and parsed like WaterMeter does, the CRC after the first block of
+// a long frame must be gone by then.
+static int benchFormatB(uint32_t frames, uint32_t gap)
+{
+  static const uint8_t lengths[] = { 44, 120, 126, 127, 140, 200, 255 };
+  const uint8_t key[16] = { 0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77,
+                            0x88, 0x99, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF };
+  std::vector<std::vector<uint8_t>> plain(frames, std::vector<uint8_t>(256));
+  std::vector<std::vector<uint8_t>> clear(frames, std::vector<uint8_t>(256));
+  std::vector<bool> bad(frames);
+  uint8_t buf[2 + WMBUS_MAX_LENGTH];
+  uint32_t received = 0, longFrames = 0, rejected = 0, verdictErrors = 0;
+  uint32_t decrypted = 0, longDecrypted = 0, mismatches = 0;
+
+  CTR<AESSmall128> ctr;
+  ctr.setKey(key, sizeof(key));
+
+  Cc1101Emulator emu;
+  Cc1101Radio radio(emu);
+
+  radio.begin();
+
+  uint64_t at = 50000;
+  for (uint32_t i = 0; i < frames; i++)
+  {
+    uint8_t len = lengths[i % sizeof(lengths)];
+    uint16_t n = makeEncryptedB(buf, plain[i].data(), clear[i].data(), len, i, ctr);
+    bad[i] = i % 4 == 3;
+    if (bad[i]) buf[i % 8 == 3 ? 20 : n - 3] ^= 0x10; // first or last block
+    emu.inject(at, buf, n, -60);
+    at += (uint64_t)n * 78 + gap;
+  }
+
+  while (hostTime < at + 100000)
+  {
+    emu.update();
+    radio.tick();
+
+    RawFrame *frame;
+    while ((frame = radio.frames().front()) != nullptr)
+    {
+      uint8_t *payload = &frame->data[2];
+      uint32_t seq = payload[1] | payload[2] << 8;
+
+      received++;
+      if (payload[0] > WMBUS_B_BLOCK + 1) longFrames++;
+      if (!frame->crcOk) rejected++;
+      if (seq >= frames || frame->crcOk == bad[seq])
+      {
+        verdictErrors++;
+        radio.frames().pop();
+        continue;
+      }
+
+      // as WaterMeter::decode and processWMBusPacket
+      uint8_t length = frame->length - 3;
+      uint8_t cipherLength = length - 2 - 16;
+      if (frame->crcOk)
+      {
+        uint8_t iv[16] = { 0 };
+        memcpy(iv, &payload[2], 8);
+        iv[8] = payload[11];
+        memcpy(&iv[9], &payload[13], 4);
+
+        bool same = frame->length == 2 + cipherLength + 17 + 2 &&
+                    memcmp(payload, plain[seq].data(), cipherLength + 17) == 0;
+        ctr.setIV(iv, sizeof(iv));
+        ctr.decrypt(&payload[17], &payload[17], cipherLength);
+
+        TelegramView telegram(&payload[17], cipherLength);
+        MeterState a;
+        copyParse(clear[seq].data(), a);
+        if (!same || memcmp(&payload[17], clear[seq].data(), cipherLength) != 0 ||
+            !telegram.valid() || telegram.totalWater() != a.totalWater ||
+            telegram.targetWater() != a.targetWater || telegram.flowTemp() != a.flowTemp ||
+            telegram.ambientTemp() != a.ambientTemp || telegram.infoCodes() != a.infoCodes)
+        {
+          mismatches++;
+        }
+        decrypted++;
+        if (payload[0] > WMBUS_B_BLOCK + 1) longDecrypted++;
+      }
+      radio.frames().pop();
+    }
+
+    delayMicroseconds(50);
+  }
+
+  Serial.printf("\nFormat B, %u telegrams, L up to 255, every 4th corrupt\n", frames);
+  Serial.printf("received: %u, with two blocks: %u, CRC rejected: %u, wrong verdicts: %u, "
+                "missed by receiver: %u\n",
+                received, longFrames, rejected, verdictErrors, emu.getStats().missed);
+  Serial.printf("decrypted: %u, with two blocks: %u, mismatches: %u\n",
+                decrypted, longDecrypted, mismatches);
+
+  return verdictErrors == 0 && mismatches == 0 && received == frames ? 0 : 1;
+}
+
+volatile uint16_t crcSink; // keeps the CRCs from being optimized away
+
+// CRC of real telegrams: C1 frames with 44 and 120 byte payloads (format
+// B, one CRC) and the blocks of format A frames (10 and 16 bytes), the
+// generic bit by bit routine against the table driven ones
+static int benchCrc(uint32_t frames)
+{
+  using Clock = std::chrono::steady_clock;
+  uint8_t buf[2 + WMBUS_MAX_LENGTH], plain[256];
+  uint8_t telegrams[4][WMBUS_MAX_LENGTH];
+  const uint16_t lengths[4] = { 43, 119, 10, 16 }; // bytes under the CRC
+  uint32_t mismatches = 0;
+
+  // from the L-field on
+  makeC1(buf, 0x12345678, 1);
+  memcpy(telegrams[0], &buf[2], lengths[0]);
+  makeTelegram(buf, 120, 2);
+  memcpy(telegrams[1], &buf[2], lengths[1]);
+  makeC1A(buf, plain, 120, 3, false);
+  memcpy(telegrams[2], &buf[2], lengths[2]);
+  memcpy(telegrams[3], &buf[2 + 12], lengths[3]);
+
+  // every length, every start of the slicing loops
+  for (uint16_t len = 0; len < 256; len++)
+  {
+    for (uint16_t i = 0; i < len; i++) plain[i] = (uint8_t)(i * 151 + len);
+    uint16_t reference = crcInternal(plain, len, 0x3D65, 0x0000, false, false);
+    if (crcEN13575(plain, len) != reference ||
+        (uint16_t)~crcEN13575Bytewise(0, plain, len) != reference ||
+#if CRC_SLICE >= 4
+        (uint16_t)~crcEN13575Slice4(0, plain, len) != reference ||
+#endif
+#if CRC_SLICE >= 8
+        (uint16_t)~crcEN13575Slice8(0, plain, len) != reference ||
+#endif
+        (uint16_t)~crcEN13575Update(crcEN13575Update(0, plain, len / 3), &plain[len / 3], len - len / 3) != reference)
+    {
+      mismatches++;
+    }
+  }
+
+  Serial.printf("\nEN 13757 CRC, %u frames each, ns per frame (MB/s)\n", frames);
+  Serial.printf("%-12s %16s %16s %16s %16s\n", "", "C1 L=44", "L=120", "A 1st block", "A 16 bytes");
+
+  auto run = [&](const char *name, auto crc)
+  {
+    Serial.printf("%-12s", name);
+    for (uint8_t t = 0; t < 4; t++)
+    {
+      uint16_t sum = 0;
+      Clock::time_point start = Clock::now();
+      for (uint32_t f = 0; f < frames; f++)
+      {
+        telegrams[t][0] ^= f & 1; // defeat hoisting
+        sum += crc(telegrams[t], lengths[t]);
+      }
+      double s = std::chrono::duration<double>(Clock::now() - start).count();
+      crcSink = sum;
+      Serial.printf(" %7.1f (%6.1f)", s * 1e9 / frames, frames * (double)lengths[t] / s / 1e6);
+    }
+    Serial.println();
+  };
+
+  run("bit by bit", [](uint8_t *p, uint16_t len) { return crcInternal(p, len, 0x3D65, 0x0000, false, false); });
+  run("table", [](uint8_t *p, uint16_t len) { return (uint16_t)~crcEN13575Bytewise(0, p, len); });
+#if CRC_SLICE >= 4
+  run("slicing-by-4", [](uint8_t *p, uint16_t len) { return (uint16_t)~crcEN13575Slice4(0, p, len); });
+#endif
+#if CRC_SLICE >= 8
+  run("slicing-by-8", [](uint8_t *p, uint16_t len) { return (uint16_t)~crcEN13575Slice8(0, p, len); });
+#endif
+
+  Serial.printf("Mismatches: %u\n", mismatches);
+  return mismatches ? 1 : 0;
+}
+
+int main(int argc, char **argv)
+{
+  uint32_t frames = argc > 1 ? atoi(argv[1]) : 200;
+  uint32_t gap = argc > 2 ? atoi(argv[2]) : 2000; // micros between telegrams
+  const char *action = argc > 3 ? argv[3] : nullptr;
+  bool glitch = action && (strcmp(action, "recover") == 0 || strcmp(action, "restart") == 0);
+  int8_t meterOffset = action && strcmp(action, "afc") == 0 ? 24 : 0; // about 38 kHz
+  bool windowing = action && strcmp(action, "window") == 0;
+  bool drift = action && strcmp(action, "drift") == 0;
+  bool noisy = action && strcmp(action, "noise") == 0;
+
+  if (action && strcmp(action, "modes") == 0)
+  {
+    return benchModes(frames);
+  }
+
+  if (action && strcmp(action, "decode3of6") == 0)
+  {
+    return benchDecoder(frames);
+  }
+
+  if (action && strcmp(action, "formata") == 0)
+  {
+    return benchFormatA(frames, gap);
+  }
+
+  if (action && strcmp(action, "formatb") == 0)
+  {
+    return benchFormatB(frames, gap);
+  }
+
+  if (action && strcmp(action, "diversity") == 0)
+  {
+    return benchDiversity(frames, gap);
+  }
+
+  if (action && strcmp(action, "registry") == 0)
+  {
+    return benchRegistry(frames);
+  }
+
+  if (action && strcmp(action, "keycache") == 0)
+  {
+    return benchKeyCache(frames);
+  }
+
+  if (action && strcmp(action, "telegram") == 0)
+  {
+    return benchTelegram(frames);
+  }
+
+  if (action && strcmp(action, "crc") == 0)
+  {
+    return benchCrc(frames);
+  }
+
+  if (action && strcmp(action, "watchdog") == 0)
+  {
+    return benchWatchdog();
+  }
+
+  Cc1101Emulator emu;
+  std::vector<uint64_t> sent; // on air time of the sync word, per telegram
+  TimeStats syncError;        // micros between true and reported sync time
+  FreqTracker afc;
+  RxScheduler scheduler;
+  bool listening = true;
+  uint32_t crcErrorsStart = 0; // CRC errors with the initial frequency
+
+  emu.gdo2Connected = !action || strcmp(action, "nogdo2") != 0;
+  Cc1101Radio radio(emu);
+  uint8_t buf[2 + WMBUS_MAX_LENGTH];
+
+  radio.begin();
+
+  // a mix of short and long telegrams, back to back with 'gap' in between
+  uint64_t at = 50000; // leave time for reset and calibration
+  for (uint32_t i = 0; i < frames; i++)
+  {
+    uint8_t len = (i % 4 == 3) ? 120 : 44;
+    uint16_t n = makeTelegram(buf, len, i);
+    if (windowing)
+    {
+      // 16 s +-10 ms, the 13th telegram doesn't make it
+      at = 50000 + i * 16000000ULL + ((i * 2654435761u) >> 16) % 21 * 1000;
+      if (i != 12) emu.inject(at, buf, n, -60 - (int16_t)(i % 30));
+      sent.push_back(at);
+      at += (uint64_t)n * 78;
+      continue;
+    }
+    emu.inject(at, buf, n, -60 - (int16_t)(i % 30), meterOffset);
+    sent.push_back(at);
+    at += (uint64_t)n * 78 + gap;
+  }
+
+  if (noisy)
+  {
+    uint32_t seed = 1;
+    for (uint32_t i = 0; i < frames * 4; i++)
+    {
+      seed = seed * 1103515245 + 12345;
+      emu.injectNoise(50000 + (seed >> 4) % (at - 50000), -104 + (int16_t)(i % 9));
+    }
+  }
+
+  uint32_t captured = 0, crcOk = 0, rssiOk = 0, driftErrors = 0, verdictErrors = 0;
+  uint64_t end = at + 100000;
+  uint64_t glitchAt = glitch ? at / 2 : UINT64_MAX;
+  uint64_t driftAt = drift ? at / 2 : UINT64_MAX;
+  uint32_t calibrations = 0;
+  uint64_t recoverAt = 0, recovered = 0;
+
+  while (hostTime < end)
+  {
+    emu.update();
+
+    if (hostTime >= glitchAt)
+    {
+      emu.glitch();
+      glitchAt = UINT64_MAX;
+      recoverAt = hostTime + 10000;
+    }
+    if (hostTime >= driftAt)
+    {
+      emu.detune(24); // inside the lock range, but frames get corrupted
+      driftAt = UINT64_MAX;
+      calibrations = radio.getCalibrations();
+    }
+    if (recoverAt && hostTime >= recoverAt)
+    {
+      if (strcmp(action, "restart") == 0)
+        radio.restart();
+      else
+        radio.recover();
+      recoverAt = 0;
+      recovered = hostTime;
+    }
+
+    radio.tick();
+
+    if (recovered && radio.getState() == RADIO_RX && hostTime > recovered + 100)
+    {
+      Serial.printf("%s: back in RX after %u us\n", action, (uint32_t)(hostTime - recovered));
+      recovered = 0;
+    }
+
+    RawFrame *frame;
+    while ((frame = radio.frames().front()) != nullptr)
+    {
+      uint8_t *payload = &frame->data[2];
+      captured++;
+      bool valid = formatBValid(payload);
+      if (frame->crcOk != valid) verdictErrors++; // CRC run along while draining
+      if (valid)
+      {
+        uint32_t seq = payload[1] | payload[2] << 8;
+        int32_t error = (int32_t)(frame->syncTime - (uint32_t)sent[seq]);
+        syncError.add(error < 0 ? -error : error);
+        crcOk++;
+        if (frame->rssi == -60 - (int16_t)(seq % 30)) rssiOk++;
+        if (meterOffset && afc.add(frame->freqEst, frame->freqOffset))
+          radio.setFreqOffset(afc.getOffset());
+        if (windowing) scheduler.frame(frame->syncTime);
+        radio.frameChecked(true);
+      }
+      else
+      {
+        afc.crcError();
+        if (afc.getCorrections() == 0) crcErrorsStart++;
+        if (drift) driftErrors++;
+        radio.frameChecked(false);
+      }
+      radio.frames().pop();
+    }
+
+    if (windowing && scheduler.listen(micros()) != listening)
+    {
+      listening = !listening;
+      if (listening)
+        radio.wake();
+      else
+        radio.sleep();
+    }
+
+    delayMicroseconds(50); // radio task wake up latency
+  }
+
+  if (windowing) scheduler.listen(micros()); // account the last sleep
+
+  const Cc1101Emulator::Stats &es = emu.getStats();
+  const TimeStats &drain = radio.getDrainTime();
+  const TimeStats &blind = radio.getBlindTime();
+  const TimeStats &config = radio.getConfigTime();
+  const SpiStats &spi = radio.getSpiStats();
+
+  Serial.printf("\nRX_STREAMING=%d RX_CONTINUOUS=%d, %u telegrams, gap %u us\n",
+                RX_STREAMING, RX_CONTINUOUS, frames, gap);
+  Serial.printf("captured: %u, CRC ok: %u, missed by receiver: %u, fifo overflows: %u\n",
+                captured, crcOk, es.missed, es.overflows);
+  Serial.printf("Radio CRC verdicts wrong: %u\n", verdictErrors);
+  Serial.printf("SPI - transactions: %u, bytes: %u, strobes: %u\n",
+                es.spiTransactions, es.spiBytes, es.strobes);
+  Serial.printf("SPI per frame - transactions: %u, bytes: %u, time: %u us\n",
+                spi.transactions / (captured ? captured : 1), spi.bytes / (captured ? captured : 1),
+                spi.time / (captured ? captured : 1));
+  Serial.printf("Per frame RSSI matches: %u of %u\n", rssiOk, crcOk);
+  Serial.printf("Sync time error (%s) - max: %u us, avg: %u us\n",
+                radio.hasSyncTimestamps() ? "GDO2" : "estimated", syncError.max, syncError.avg());
+  Serial.printf("Config - loads: %u, last: %u us\n", config.count, config.last);
+  if (windowing)
+  {
+    Serial.printf("RX windows - interval: %u us, jitter: %u us, windows: %u, misses: %u\n",
+                  scheduler.getInterval(), scheduler.getJitter(), scheduler.getWindows(),
+                  scheduler.getMisses());
+    Serial.printf("RX windows - radio asleep: %u of %u ms (%u%%)\n", radio.getSleepTime(),
+                  (uint32_t)(hostTime / 1000), (uint32_t)(radio.getSleepTime() * 100 / (hostTime / 1000)));
+  }
+  if (meterOffset)
+  {
+    Serial.printf("AFC - meter offset: %d, correction: %d (%d Hz), corrections: %u\n",
+                  meterOffset, radio.getFreqOffset(), afc.getOffsetHz(), afc.getCorrections());
+    Serial.printf("AFC - CRC errors before: %u, since last correction: %u.%u%%, "
+                  "before it: %u.%u%%, off frequency: %u, corrupted: %u\n",
+                  crcErrorsStart, afc.errorRate() / 10, afc.errorRate() % 10,
+                  afc.prevRate() / 10, afc.prevRate() % 10, es.offFrequency, es.corrupted);
+  }
+  if (noisy)
+  {
+    char json[256];
+    radio.wakeupsToJson(json, sizeof(json));
+    Serial.printf("Noise - gated by the CC1101: %u, wakeups %s\n", es.gated, json);
+  }
+  if (drift)
+  {
+    Serial.printf("Drift - CRC errors: %u, calibrations since: %u\n",
+                  driftErrors, radio.getCalibrations() - calibrations);
+  }
+  Serial.printf("FIFO drain - last: %u us, max: %u us, avg: %u us\n",
+                drain.last, drain.max, drain.avg());
+  Serial.printf("RX blind time - last: %u us, max: %u us, avg: %u us\n",
+                blind.last, blind.max, blind.avg());
+
+  return 0;
+}
@@ -0,0 +1,45 @@
+#ifndef __CC1101BUS_H__
+#define __CC1101BUS_H__
+
+#include <Arduino.h>
+
+// transport between the CC1101 driver and one chip:
+// chip select, SPI transfers, MISO (chip ready) and the GDO interrupts
+// Cc1101SpiBus is the hardware implementation, the host build uses an
+// emulated chip instead
+class Cc1101Bus
+{
+  public:
+    virtual ~Cc1101Bus() {}
+
+    // setup pins and SPI
+    virtual void begin(void) = 0;
+
+    // chip select assert/deassert
+    virtual void select(void) = 0;
+    virtual void deselect(void) = 0;
+
+    // true, if the chip pulls MISO low (CHIP_RDYn), only valid while selected
+    virtual bool misoLow(void) = 0;
+
+    // false, while another chip on a shared SPI bus is selected, e.g. it
+    // waits for its crystal with chip select asserted
+    virtual bool available(void) { return true; }
+
+    // full duplex transfer of a single byte
+    virtual uint8_t transfer(uint8_t value) = 0;
+
+    // MOSI low and SCK high, needed for the manual power on reset
+    virtual void resetPins(void) = 0;
+
+    // GDO0 edge interrupt, mode is RISING or FALLING
+    virtual void attachGdo0(void (*isr)(void *), void *arg, int mode) = 0;
+    virtual void detachGdo0(void) = 0;
+
+    // GDO2 edge interrupt, GDO2 is optional
+    // returns false, if it isn't connected
+    virtual bool attachGdo2(void (*isr)(void *), void *arg, int mode) = 0;
+    virtual void detachGdo2(void) = 0;
+};
+
+#endif // __CC1101BUS_H__
@@ -0,0 +1,813 @@
+/*
+ Copyright (C) 2020 chester4444@wolke7.net
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _CC1101RADIO_H_
+#define _CC1101RADIO_H_
+
+#include <Arduino.h>
+#include <atomic>
+#if defined(ARDUINO)
+  #include "config.h"
+#endif
+#include "Cc1101Bus.h"
+#include "FrameQueue.h"
+#include "utils.h"
+#include "Decoder3of6.h"
+#include "FormatAChecker.h"
+
+// drain the RX FIFO on threshold interrupts while the frame is arriving,
+// needed for frames longer than the 64 byte FIFO
+#ifndef RX_STREAMING
+#define RX_STREAMING 0
+#endif
+
+// switch to fixed packet length as soon as the L-field is known and let
+// the CC1101 stay in RX after the frame (no SIDLE/SFRX/SRX in between)
+#ifndef RX_CONTINUOUS
+#define RX_CONTINUOUS 0
+#endif
+
+#if RX_CONTINUOUS && !RX_STREAMING
+#error "RX_CONTINUOUS needs RX_STREAMING"
+#endif
+
+// keep the synthesizer calibration (FSCAL3..FSCAL1) of one SCAL and write
+// it back before RX, instead of calibrating on every IDLE to RX transition
+// (MCSM0.FS_AUTOCAL) and after each reset
+#ifndef RX_FSCAL_CACHE
+#define RX_FSCAL_CACHE 0
+#endif
+
+// with RX_FSCAL_CACHE a new calibration is done between frames, if the
+// CRC error rate of a window of FSCAL_TREND_WINDOW frames rises
+// FSCAL_TREND_RISE per mille above the first window after the last
+// calibration, if the temperature moved FSCAL_TEMP_DELTA degrees or the
+// calibration is FSCAL_MAX_AGE millis old
+#ifndef FSCAL_TREND_WINDOW
+#define FSCAL_TREND_WINDOW 16
+#endif
+#ifndef FSCAL_TREND_RISE
+#define FSCAL_TREND_RISE 150
+#endif
+#ifndef FSCAL_TEMP_DELTA
+#define FSCAL_TEMP_DELTA 10
+#endif
+#ifndef FSCAL_MAX_AGE
+#define FSCAL_MAX_AGE 3600000UL
+#endif
+
+#define FSCAL_NO_TEMPERATURE INT16_MIN // not known (yet)
+
+// gating of sync word hits in the CC1101, fewer false wakeups on a noisy band
+// RX_PQT: a sync word only counts after a preamble of quality 4 * RX_PQT
+// (PKTCTRL1.PQT, 0 .. 7, 0: off)
+// RX_CS_REL: carrier sense above the noise floor (AGCCTRL1, used by
+// MDMCFG2.SYNC_MODE 6), 0: off, 1: +6 dB, 2: +10 dB, 3: +14 dB
+// RX_CS_ABS: absolute carrier sense threshold in dB around MAGN_TARGET
+// (AGCCTRL1), -7 .. 7, -8: off
+#ifndef RX_PQT
+#define RX_PQT 0
+#endif
+#ifndef RX_CS_REL
+#define RX_CS_REL 0
+#endif
+#ifndef RX_CS_ABS
+#define RX_CS_ABS -7
+#endif
+
+// read the registers back after programming, reset the chip on a mismatch
+#ifndef RADIO_VERIFY_CONFIG
+#define RADIO_VERIFY_CONFIG 1
+#endif
+
+// RF register profile loaded at start, see RadioProfile
+#ifndef RADIO_PROFILE
+#define RADIO_PROFILE PROFILE_C1
+#endif
+
+// number of raw frames buffered between capture and decode, power of 2
+#ifndef FRAME_QUEUE_SIZE
+#define FRAME_QUEUE_SIZE 8
+#endif
+
+#define MARCSTATE_SLEEP            0x00
+#define MARCSTATE_IDLE             0x01
+#define MARCSTATE_XOFF             0x02
+#define MARCSTATE_VCOON_MC         0x03
+#define MARCSTATE_REGON_MC         0x04
+#define MARCSTATE_MANCAL           0x05
+#define MARCSTATE_VCOON            0x06
+#define MARCSTATE_REGON            0x07
+#define MARCSTATE_STARTCAL         0x08
+#define MARCSTATE_BWBOOST          0x09
+#define MARCSTATE_FS_LOCK          0x0A
+#define MARCSTATE_IFADCON          0x0B
+#define MARCSTATE_ENDCAL           0x0C
+#define MARCSTATE_RX               0x0D
+#define MARCSTATE_RX_END           0x0E
+#define MARCSTATE_RX_RST           0x0F
+#define MARCSTATE_TXRX_SWITCH      0x10
+#define MARCSTATE_RXFIFO_OVERFLOW  0x11
+#define MARCSTATE_FSTXON           0x12
+#define MARCSTATE_TX               0x13
+#define MARCSTATE_TX_END           0x14
+#define MARCSTATE_RXTX_SWITCH      0x15
+#define MARCSTATE_TXFIFO_UNDERFLOW 0x16
+
+#define WRITE_BURST              0x40
+#define READ_SINGLE              0x80
+#define READ_BURST               0xC0
+
+#define CC1101_CONFIG_REGISTER   READ_SINGLE
+#define CC1101_STATUS_REGISTER   READ_BURST
+
+#define CC1101_PATABLE           0x3E        // PATABLE address
+#define CC1101_TXFIFO            0x3F        // TX FIFO address
+#define CC1101_RXFIFO            0x3F        // RX FIFO address
+
+#define CC1101_SRES              0x30        // Reset CC1101 chip
+#define CC1101_SFSTXON           0x31        // Enable and calibrate frequency synthesizer (if MCSM0.FS_AUTOCAL=1). If in RX (with CCA):
+                                             // Go to a wait state where only the synthesizer is running (for quick RX / TX turnaround).
+#define CC1101_SXOFF             0x32        // Turn off crystal oscillator
+#define CC1101_SCAL              0x33        // Calibrate frequency synthesizer and turn it off. SCAL can be strobed from IDLE mode without
+                                             // setting manual calibration mode (MCSM0.FS_AUTOCAL=0)
+#define CC1101_SRX               0x34        // Enable RX. Perform calibration first if coming from IDLE and MCSM0.FS_AUTOCAL=1
+#define CC1101_STX               0x35        // In IDLE state: Enable TX. Perform calibration first if MCSM0.FS_AUTOCAL=1.
+                                             // If in RX state and CCA is enabled: Only go to TX if channel is clear
+#define CC1101_SIDLE             0x36        // Exit RX / TX, turn off frequency synthesizer and exit Wake-On-Radio mode if applicable
+#define CC1101_SWOR              0x38        // Start automatic RX polling sequence (Wake-on-Radio) as described in Section 19.5 if
+                                             // WORCTRL.RC_PD=0
+#define CC1101_SPWD              0x39        // Enter power down mode when CSn goes high
+#define CC1101_SFRX              0x3A        // Flush the RX FIFO buffer. Only issue SFRX in IDLE or RXFIFO_OVERFLOW states
+#define CC1101_SFTX              0x3B        // Flush the TX FIFO buffer. Only issue SFTX in IDLE or TXFIFO_UNDERFLOW states
+#define CC1101_SWORRST           0x3C        // Reset real time clock to Event1 value
+#define CC1101_SNOP              0x3D        // No operation. May be used to get access to the chip status byte
+
+#define CC1101_IOCFG2            0x00        // GDO2 Output Pin Configuration
+#define CC1101_IOCFG1            0x01        // GDO1 Output Pin Configuration
+#define CC1101_IOCFG0            0x02        // GDO0 Output Pin Configuration
+#define CC1101_FIFOTHR           0x03        // RX FIFO and TX FIFO Thresholds
+#define CC1101_SYNC1             0x04        // Sync Word, High Byte
+#define CC1101_SYNC0             0x05        // Sync Word, Low Byte
+#define CC1101_PKTLEN            0x06        // Packet Length
+#define CC1101_PKTCTRL1          0x07        // Packet Automation Control
+#define CC1101_PKTCTRL0          0x08        // Packet Automation Control
+#define CC1101_ADDR              0x09        // Device Address
+#define CC1101_CHANNR            0x0A        // Channel Number
+#define CC1101_FSCTRL1           0x0B        // Frequency Synthesizer Control
+#define CC1101_FSCTRL0           0x0C        // Frequency Synthesizer Control
+#define CC1101_FREQ2             0x0D        // Frequency Control Word, High Byte
+#define CC1101_FREQ1             0x0E        // Frequency Control Word, Middle Byte
+#define CC1101_FREQ0             0x0F        // Frequency Control Word, Low Byte
+#define CC1101_MDMCFG4           0x10        // Modem Configuration
+#define CC1101_MDMCFG3           0x11        // Modem Configuration
+#define CC1101_MDMCFG2           0x12        // Modem Configuration
+#define CC1101_MDMCFG1           0x13        // Modem Configuration
+#define CC1101_MDMCFG0           0x14        // Modem Configuration
+#define CC1101_DEVIATN           0x15        // Modem Deviation Setting
+#define CC1101_MCSM2             0x16        // Main Radio Control State Machine Configuration
+#define CC1101_MCSM1             0x17        // Main Radio Control State Machine Configuration
+#define CC1101_MCSM0             0x18        // Main Radio Control State Machine Configuration
+#define CC1101_FOCCFG            0x19        // Frequency Offset Compensation Configuration
+#define CC1101_BSCFG             0x1A        // Bit Synchronization Configuration
+#define CC1101_AGCCTRL2          0x1B        // AGC Control
+#define CC1101_AGCCTRL1          0x1C        // AGC Control
+#define CC1101_AGCCTRL0          0x1D        // AGC Control
+#define CC1101_WOREVT1           0x1E        // High Byte Event0 Timeout
+#define CC1101_WOREVT0           0x1F        // Low Byte Event0 Timeout
+#define CC1101_WORCTRL           0x20        // Wake On Radio Control
+#define CC1101_FREND1            0x21        // Front End RX Configuration
+#define CC1101_FREND0            0x22        // Front End TX Configuration
+#define CC1101_FSCAL3            0x23        // Frequency Synthesizer Calibration
+#define CC1101_FSCAL2            0x24        // Frequency Synthesizer Calibration
+#define CC1101_FSCAL1            0x25        // Frequency Synthesizer Calibration
+#define CC1101_FSCAL0            0x26        // Frequency Synthesizer Calibration
+#define CC1101_RCCTRL1           0x27        // RC Oscillator Configuration
+#define CC1101_RCCTRL0           0x28        // RC Oscillator Configuration
+#define CC1101_FSTEST            0x29        // Frequency Synthesizer Calibration Control
+#define CC1101_PTEST             0x2A        // Production Test
+#define CC1101_AGCTEST           0x2B        // AGC Test
+#define CC1101_TEST2             0x2C        // Various Test Settings
+#define CC1101_TEST1             0x2D        // Various Test Settings
+#define CC1101_TEST0             0x2E        // Various Test Settings
+
+#define CC1101_PARTNUM           0x30        // Chip ID
+#define CC1101_VERSION           0x31        // Chip ID
+#define CC1101_FREQEST           0x32        // Frequency Offset Estimate from Demodulator
+#define CC1101_LQI               0x33        // Demodulator Estimate for Link Quality
+#define CC1101_RSSI              0x34        // Received Signal Strength Indication
+#define CC1101_MARCSTATE         0x35        // Main Radio Control State Machine State
+#define CC1101_WORTIME1          0x36        // High Byte of WOR Time
+#define CC1101_WORTIME0          0x37        // Low Byte of WOR Time
+#define CC1101_PKTSTATUS         0x38        // Current GDOx Status and Packet Status
+#define CC1101_VCO_VC_DAC        0x39        // Current Setting from PLL Calibration Module
+#define CC1101_TXBYTES           0x3A        // Underflow and Number of Bytes
+#define CC1101_RXBYTES           0x3B        // Overflow and Number of Bytes
+#define CC1101_RCCTRL1_STATUS    0x3C        // Last RC Oscillator Calibration Result
+#define CC1101_RCCTRL0_STATUS    0x3D        // Last RC Oscillator Calibration Result
+
+#define CC1101_DEFVAL_SYNC1      0x54        // Synchronization word, high byte
+#define CC1101_DEFVAL_SYNC0      0x3D        // Synchronization word, low byte
+#if RX_CONTINUOUS
+#define CC1101_DEFVAL_MCSM1      0x0C        // RXOFF_MODE: stay in RX after a packet
+#else
+#define CC1101_DEFVAL_MCSM1      0x00        // Main Radio Control State Machine Configuration
+#endif
+
+#define CC1101_DEFVAL_IOCFG2     0x06        // GDO2 asserts on sync word, deasserts at end of packet
+#define CC1101_DEFVAL_IOCFG1     0x2E        // GDO1 Output Pin Configuration (reset value)
+#if RX_STREAMING
+#define CC1101_DEFVAL_IOCFG0     0x00        // GDO0 asserts when RX FIFO is filled at or above threshold
+#define CC1101_GDO0_EDGE         RISING
+#else
+#define CC1101_DEFVAL_IOCFG0     0x06        // GDO0 deasserts at end of packet or RX FIFO overflow
+#define CC1101_GDO0_EDGE         FALLING
+#endif
+
+#define CC1101_DEFVAL_FSCTRL1    0x08        // Frequency Synthesizer Control
+#define CC1101_DEFVAL_FSCTRL0    0x00        // Frequency Synthesizer Control
+#define CC1101_DEFVAL_FREQ2      0x21        // Frequency Control Word, High Byte
+#define CC1101_DEFVAL_FREQ1      0x6B        // Frequency Control Word, Middle Byte
+#define CC1101_DEFVAL_FREQ0      0xD0        // Frequency Control Word, Low Byte
+#define CC1101_DEFVAL_MDMCFG4    0x5C        // Modem configuration. Speed = 103 Kbps
+#define CC1101_DEFVAL_MDMCFG3    0x04        // Modem Configuration
+#define CC1101_DEFVAL_MDMCFG2    0x06        // Modem Configuration
+#define CC1101_DEFVAL_MDMCFG1    0x22        // Modem Configuration
+#define CC1101_DEFVAL_MDMCFG0    0xF8        // Modem Configuration
+#define CC1101_DEFVAL_CHANNR     0x00        // Channel Number
+#define CC1101_DEFVAL_DEVIATN    0x44        // Modem Deviation Setting
+#define CC1101_DEFVAL_FREND1     0xB6        // Front End RX Configuration
+#define CC1101_DEFVAL_FREND0     0x10        // Front End TX Configuration
+#if RX_FSCAL_CACHE
+#define CC1101_DEFVAL_MCSM0      0x08        // no auto calibration, FSCAL3..1 restored before RX
+#else
+#define CC1101_DEFVAL_MCSM0      0x18        // Main Radio Control State Machine Configuration
+#endif
+#define CC1101_DEFVAL_MCSM2      0x07        // Main Radio Control State Machine Configuration (reset value)
+#define CC1101_DEFVAL_FOCCFG     0x2E      // Frequency Offset Compensation Configuration
+#define CC1101_DEFVAL_BSCFG      0xBF        // Bit Synchronization Configuration
+#define CC1101_DEFVAL_AGCCTRL2   0x43        // AGC Control
+#define CC1101_DEFVAL_AGCCTRL1   (RX_CS_REL << 4 | (RX_CS_ABS & 0x0F)) // carrier sense thresholds
+#define CC1101_DEFVAL_AGCCTRL0   0xB5        // AGC Control
+#define CC1101_DEFVAL_WOREVT1    0x87        // High Byte Event0 Timeout (reset value)
+#define CC1101_DEFVAL_WOREVT0    0x6B        // Low Byte Event0 Timeout (reset value)
+#define CC1101_DEFVAL_WORCTRL    0xF8        // Wake On Radio Control (reset value)
+#define CC1101_DEFVAL_RCCTRL1    0x41        // RC Oscillator Configuration (reset value)
+#define CC1101_DEFVAL_RCCTRL0    0x00        // RC Oscillator Configuration (reset value)
+#define CC1101_DEFVAL_FSCAL3     0xEA        // Frequency Synthesizer Calibration
+#define CC1101_DEFVAL_FSCAL2     0x2A        // Frequency Synthesizer Calibration
+#define CC1101_DEFVAL_FSCAL1     0x00        // Frequency Synthesizer Calibration
+#define CC1101_DEFVAL_FSCAL0     0x1F        // Frequency Synthesizer Calibration
+#define CC1101_DEFVAL_FSTEST     0x59        // Frequency Synthesizer Calibration Control
+#define CC1101_DEFVAL_PTEST      0x7F        // Production Test (reset value)
+#define CC1101_DEFVAL_AGCTEST    0x3F        // AGC Test (reset value)
+#define CC1101_DEFVAL_TEST2      0x81        // Various Test Settings
+#define CC1101_DEFVAL_TEST1      0x35        // Various Test Settings
+#define CC1101_DEFVAL_TEST0      0x09        // Various Test Settings
+#if RX_CONTINUOUS
+#define CC1101_DEFVAL_PKTCTRL1   (RX_PQT << 5 | 0x04) // PQT, APPEND_STATUS: RSSI and LQI after fixed length frames
+#else
+#define CC1101_DEFVAL_PKTCTRL1   (RX_PQT << 5) // PQT: preamble quality needed for a sync word
+#endif
+#define CC1101_DEFVAL_PKTCTRL0   0x02        // 2 - infinite length
+#define CC1101_DEFVAL_ADDR       0x00        // Device Address
+#define CC1101_DEFVAL_PKTLEN     0x30        // Packet Length
+#if RX_CONTINUOUS
+#define CC1101_DEFVAL_FIFOTHR    0x00        // RX 4 bytes, get the L-field early
+#elif RX_STREAMING
+#define CC1101_DEFVAL_FIFOTHR    0x07        // RX 32 bytes and TX 33 bytes Thresholds
+#else
+#define CC1101_DEFVAL_FIFOTHR    0x00        // RX 4 bytes and TX 61 bytes Thresholds
+#endif
+
+#define CC1101_FIFO_SIZE         64          // RX FIFO size in bytes
+#define CC1101_BYTE_TIME         78          // micros per byte on air at 103 kbps
+#define CC1101_SYNC_SLACK        1000        // micros a GDO2 sync word time may be older
+                                             // than the fifo bytes tell, else it's stale
+#define CC1101_CONFIG_SIZE       (CC1101_TEST0 + 1) // configuration registers IOCFG2 .. TEST0
+#define CC1101_NARROW_MDMCFG4    0x6C        // RX filter 270 kHz instead of 325 kHz
+#define CC1101_T1_MDMCFG4        0x5B        // mode T1: RX filter 325 kHz, DRATE_E 11
+#define CC1101_T1_MDMCFG3        0xF8        // mode T1: 100 kcps
+#define CC1101_T1_DEVIATN        0x50        // mode T1: 50 kHz deviation
+#define CC1101_SPOT_CHECK_SIZE   4           // registers read by the spot check
+
+#define CC1101_PKTCTRL0_FIXED    0x00        // fixed length, set once the L-field is known
+#define CC1101_FIFOTHR_FRAME     0x07        // RX 32 bytes, for the rest of the frame
+
+#define WMBUS_MIN_LENGTH         10          // L-field of the shortest frame: C-, M-, A- and CI-field
+#define WMBUS_MAX_LENGTH         256         // L-field + up to 255 bytes
+#define WMBUS_MAX_CODED          436         // 3-out-of-6 coded format A frame, L-field 255
+#define WMBUS_B_BLOCK            126         // format B: L-field + data of the first block, its
+                                             // CRC is followed by a second block if L > 127
+
+// maximum number of accesses in one Cc1101Batch
+#define CC1101_BATCH_SIZE        8
+
+// SPI access types, for Cc1101Batch and SpiStats
+enum SpiOp : uint8_t
+{
+  SPI_STROBE,       // command strobe
+  SPI_READ,         // single register read (config or status)
+  SPI_WRITE,        // single register write
+  SPI_READ_BURST,   // burst read, e.g. RX FIFO
+  SPI_WRITE_BURST,  // burst write, e.g. register profile
+  SPI_OP_COUNT
+};
+
+// several CC1101 accesses, executed in a single chip select window by
+// Cc1101Radio::run(). Strobes and single accesses can be chained, the
+// CC1101 expects a new header byte after each of them. A burst access
+// only ends with CS going high, so it must be the last one.
+class Cc1101Batch
+{
+  public:
+    struct Op
+    {
+      SpiOp type;
+      uint8_t header;   // address | access bits, or strobe command
+      uint8_t len;      // data bytes, burst only
+      uint8_t value;    // single write
+      uint8_t *dst;     // read target
+      const uint8_t *src; // burst write source
+    };
+
+  private:
+    Op ops[CC1101_BATCH_SIZE];
+    uint8_t count = 0;
+    bool closed = false;  // burst added, nothing can follow
+    bool invalid = false; // too many ops or op after a burst
+
+    Op *add(SpiOp type, uint8_t header)
+    {
+      if (count >= CC1101_BATCH_SIZE || closed)
+      {
+        invalid = true;
+        return nullptr;
+      }
+      Op *op = &ops[count++];
+      op->type = type;
+      op->header = header;
+      op->len = 0;
+      op->dst = nullptr;
+      op->src = nullptr;
+      return op;
+    }
+
+  public:
+    Cc1101Batch &strobe(uint8_t cmd)
+    {
+      add(SPI_STROBE, cmd);
+      return *this;
+    }
+
+    Cc1101Batch &write(uint8_t regAddr, uint8_t value)
+    {
+      Op *op = add(SPI_WRITE, regAddr);
+      if (op) op->value = value;
+      return *this;
+    }
+
+    // regType: CC1101_CONFIG_REGISTER or CC1101_STATUS_REGISTER
+    Cc1101Batch &read(uint8_t regAddr, uint8_t regType, uint8_t *value)
+    {
+      Op *op = add(SPI_READ, regAddr | regType);
+      if (op) op->dst = value;
+      return *this;
+    }
+
+    Cc1101Batch &readBurst(uint8_t regAddr, uint8_t *buffer, uint8_t len)
+    {
+      Op *op = add(SPI_READ_BURST, regAddr | READ_BURST);
+      if (op) { op->dst = buffer; op->len = len; closed = true; }
+      return *this;
+    }
+
+    Cc1101Batch &writeBurst(uint8_t regAddr, const uint8_t *buffer, uint8_t len)
+    {
+      Op *op = add(SPI_WRITE_BURST, regAddr | WRITE_BURST);
+      if (op) { op->src = buffer; op->len = len; closed = true; }
+      return *this;
+    }
+
+    uint8_t size(void) const { return count; }
+    bool isValid(void) const { return !invalid; }
+    const Op &operator[](uint8_t i) const { return ops[i]; }
+};
+
+// SPI usage, per access type
+struct SpiStats
+{
+  uint32_t transactions = 0;  // chip select windows
+  uint32_t bytes = 0;
+  uint32_t time = 0;          // micros incl. waiting for the chip
+  uint32_t count[SPI_OP_COUNT] = {};
+  uint32_t opTime[SPI_OP_COUNT] = {}; // micros per access type
+};
+
+// raw frame as captured from the CC1101, before any checking
+struct RawFrame
+{
+  uint32_t timestamp;  // millis at start of capture
+  uint32_t syncTime;   // micros at end of sync word, from GDO2 if connected,
+                       // otherwise estimated from the bytes in the fifo
+  int16_t rssi;        // dBm, appended by the CC1101 or latched at start of capture
+  uint8_t lqi;         // link quality indicator, lower is better
+  int8_t freqEst;      // frequency offset estimate (FREQEST), Fxosc/2^14 per step
+  int8_t freqOffset;   // frequency correction (FSCTRL0) the frame was received with
+  uint8_t profile;     // RadioProfile the frame was received with
+  uint8_t radio;       // receiver the frame came from, set by FrameMerger
+  bool formatA;        // frame format A, the block CRCs were checked and removed,
+                       // otherwise format B with its CRC at the end, a long one
+                       // (L > 127) without the CRC after its first block
+  bool crcOk;          // format B: its CRC(s) checked while draining, format A: always,
+                       // frames with a block CRC error are dropped by the radio
+  uint16_t length;     // valid bytes in data, the L-field still counts removed CRCs
+  uint8_t data[WMBUS_MAX_CODED]; // preamble + L-field + payload, or for mode T1
+                                 // L-field + payload decoded in place
+};
+
+
+// RF register profiles, the tables are in Cc1101Radio.cpp
+enum RadioProfile : uint8_t
+{
+  PROFILE_C1,        // WMBus mode C1, 868.95 MHz, 103 kbps, 325 kHz RX filter
+  PROFILE_C1_NARROW, // as C1 with a 270 kHz RX filter, more sensitive but
+                     // less tolerant to crystal offsets
+  PROFILE_T1,        // WMBus mode T1, 868.95 MHz, 100 kcps 3-out-of-6 coded,
+                     // frame format A, needs RX_STREAMING
+  PROFILE_COUNT
+};
+
+// graduated recovery, cheapest first, see Cc1101Radio::recover()
+enum RecoveryStage : uint8_t
+{
+  RECOVER_RX,        // SRX again, the chip dropped out of RX
+  RECOVER_FLUSH,     // flush the RX FIFO and restart RX, FIFO overflow
+  RECOVER_CALIBRATE, // recalibrate the synthesizer, stuck in another state or
+                     // expected frames missed
+  RECOVER_RESTORE,   // rewrite the registers from the shadow copy, configuration lost
+  RECOVER_RESET,     // power on reset and full configuration
+  RECOVER_STAGES
+};
+
+// a symptom within this many millis after a recovery, without a frame in
+// between, escalates to the next stage
+#ifndef RECOVER_ESCALATE
+#define RECOVER_ESCALATE 60000UL
+#endif
+
+#define RECOVER_BUCKETS 8 // time to recover histogram, bucket n: below 512 us << n
+
+// recoveries of one stage
+struct RecoveryStats
+{
+  uint32_t count = 0;     // applied
+  uint32_t escalated = 0; // applied because a lower stage didn't help
+  TimeStats time;         // micros until back in RX
+  uint16_t histogram[RECOVER_BUCKETS] = {}; // time until back in RX, the last
+                                            // bucket includes everything above
+
+  void add(uint32_t t)
+  {
+    uint8_t i = 0;
+    while (i < RECOVER_BUCKETS - 1 && t >= (512UL << i)) i++;
+    histogram[i]++;
+    time.add(t);
+  }
+};
+
+// what a receiver wakeup (sync word hit) turned out to be
+enum WakeupClass : uint8_t
+{
+  WAKEUP_FRAME,      // frame handed to the decode stage
+  WAKEUP_HEADER,     // preamble or L-field can't be WMBus, noise
+  WAKEUP_CODING,     // invalid 3-out-of-6 code, noise
+  WAKEUP_BLOCK_CRC,  // format A block with a CRC error, dropped before its end
+  WAKEUP_TRUNCATED,  // bytes stopped arriving or FIFO overflow
+  WAKEUP_CLASSES
+};
+
+// receiver wakeups, noise versus telegrams, for tuning the gating
+struct WakeupStats
+{
+  uint32_t count[WAKEUP_CLASSES] = {};
+  uint32_t crcErrors = 0;  // format B frames the decode stage found corrupt
+  uint32_t noiseBytes = 0; // FIFO bytes read for wakeups that weren't frames
+  uint32_t noiseTime = 0;  // micros of SPI spent on them
+};
+
+// radio control states, see Cc1101Radio::tick()
+enum RadioState : uint8_t
+{
+  RADIO_RESET,       // power on reset pending
+  RADIO_RESET_WAIT,  // SRES sent, waiting for chip ready
+  RADIO_CALIBRATE,   // registers written, SCAL sent, waiting for IDLE
+  RADIO_IDLE_WAIT,   // SIDLE sent, waiting for IDLE
+  RADIO_RX_WAIT,     // SFRX + SRX sent, waiting for RX
+  RADIO_RX,          // receiving
+  RADIO_SLEEP,       // powered down (SPWD) between receive windows
+  RADIO_WAKE_WAIT    // CS low after SLEEP, waiting for the crystal
+};
+
+// CC1101 driver for WMBus mode C1 reception
+// all radio control is done in tick(), which never blocks for more than
+// a single SPI transaction; waiting for the chip is done with timeouts
+class Cc1101Radio
+{
+  private:
+    const uint32_t FIFO_TIMEOUT = 30000UL;  // in micros, max time to wait for frame bytes
+    const uint32_t MISO_TIMEOUT = 1000UL;   // in micros, max time to wait for chip ready
+    const uint32_t RESET_TIMEOUT = 10000UL; // in micros, SRES until chip ready
+    const uint32_t CAL_TIMEOUT = 10000UL;   // in micros, SCAL until IDLE
+    const uint32_t IDLE_TIMEOUT = 5000UL;   // in micros, SIDLE until IDLE
+    const uint32_t RX_TIMEOUT = 10000UL;    // in micros, SRX until RX (incl. auto calibration)
+    const uint32_t WAKE_TIMEOUT = 2000UL;   // in micros, CS low until chip ready after SLEEP
+    const uint8_t MAX_RETRIES = 3;          // failed state changes before a full reset
+
+    volatile RadioState state = RADIO_RESET;
+    uint32_t stateEntered = 0;    // micros
+    uint32_t stateTimeout = 0;    // in micros, 0: no timeout
+    uint8_t retries = 0;
+    std::atomic<bool> resetRequest{false};
+    volatile boolean packetAvailable = false;
+
+    // sync word timestamp, set by the GDO2 interrupt
+    volatile uint32_t syncTime = 0;
+    volatile boolean syncSeen = false;
+    bool gdo2Attached = false;
+
+    // capture stage (producer) -> decode stage (consumer)
+    FrameQueue<RawFrame, FRAME_QUEUE_SIZE> frameQueue;
+    RawFrame *rxFrame = nullptr; // queue slot being filled
+#if RX_STREAMING
+    uint16_t rxPos = 0; // bytes of the current frame read so far
+    uint16_t rxLen = 0; // expected frame length incl. preamble, 0 if unknown yet
+    uint8_t rxStatusLen = 0; // status bytes appended by the CC1101 after the frame
+    uint32_t rxLastChunk = 0; // micros of last fifo drain
+    uint32_t rxDrainTime = 0; // spi time spent on the current frame
+    Decoder3of6 rxDecoder;    // mode T1: decodes the frame in place while draining
+    FormatAChecker rxBlocks;  // format A: block CRCs checked and removed while draining
+    bool rxFormatA = false;
+    uint16_t rxBlocksFed = 0; // frame bytes from the L-field on given to rxBlocks
+    uint16_t rxCrc = 0;       // format B: CRC register over the bytes drained so far
+    uint16_t rxCrcFed = 0;    // frame bytes given to rxCrc
+    uint16_t rxCrcEnd = 0;    // end of the block rxCrc is over
+    bool rxCrcOk = true;      // CRC of the first block, if the frame has two
+#endif
+#if RX_CONTINUOUS
+    bool rxFixedLength = false; // CC1101 ends the current frame by itself
+#endif
+    bool blindPending = false; // receiver restart after a frame in progress
+    uint32_t frameEnd = 0;     // micros, last byte of the last frame drained
+    uint32_t lastStatusOutput = 0;
+
+    TimeStats drainTime; // micros to drain the FIFO, per frame
+    TimeStats blindTime; // micros from end of frame until ready for the next one
+
+    // state machine statistics
+    uint32_t resetCount = 0;
+    uint32_t timeoutCount = 0;
+    uint32_t misoTimeouts = 0;
+    uint32_t configErrors = 0;
+    TimeStats configTime; // micros to program and verify the registers
+    SpiStats spiStats;
+    uint32_t frameCount = 0; // frames committed, for SPI usage per frame
+
+    RadioProfile profile = RADIO_PROFILE;
+    std::atomic<RadioProfile> profileRequest{RADIO_PROFILE};
+    uint32_t profileSwitches = 0;
+    WakeupStats wakeups;
+    volatile uint32_t gdo0Interrupts = 0;
+
+    // configuration registers as written, valid after the profile is loaded
+    uint8_t shadow[CC1101_CONFIG_SIZE];
+    bool shadowValid = false;
+    std::atomic<uint8_t> recoverRequest{0}; // RecoveryStage + 1, 0: none
+    std::atomic<bool> checkRequest{false};  // health check before the next frame
+    uint32_t skippedWrites = 0;   // writes of values the chip already has
+    uint32_t silentResets = 0;    // spot check found lost configuration
+    uint32_t restoredRegs = 0;    // registers rewritten from the shadow copy
+
+    // frequency correction, FSCTRL0 steps, requested by the decode stage
+    std::atomic<int8_t> freqOffsetRequest{0};
+    int8_t freqOffset = 0;        // FSCTRL0 in effect
+    uint32_t freqCorrections = 0;
+
+    // graduated recovery
+    RecoveryStats recovery[RECOVER_STAGES];
+    int8_t recovering = -1;     // stage applied, until back in RX
+    uint32_t recoverStart = 0;  // micros
+    int8_t lastStage = -1;      // stage applied last, until a frame arrives
+    uint32_t lastRecovery = 0;  // millis
+    bool calibratePending = false; // SCAL once IDLE, before RX
+
+    // synthesizer calibration
+#if RX_FSCAL_CACHE
+    uint8_t fscal[3];             // FSCAL3..FSCAL1 of the last SCAL
+    bool fscalValid = false;
+    uint32_t fscalRestores = 0;   // RX entries with the cached calibration
+#endif
+    std::atomic<bool> calibrateRequest{false};
+    std::atomic<int16_t> temperature{FSCAL_NO_TEMPERATURE}; // from the decode stage
+    uint32_t calibrations = 0;    // SCAL done
+    uint32_t calTime = 0;         // millis of the last SCAL
+    int16_t calTemperature = FSCAL_NO_TEMPERATURE; // at the last SCAL
+    uint32_t calRequested = 0;    // by calibrate() or the CRC error trend
+    uint32_t calTemperatureChanges = 0;
+    uint32_t calExpired = 0;      // FSCAL_MAX_AGE reached
+
+    // CRC error trend, decode stage only
+    std::atomic<bool> trendReset{false}; // calibrated, start over
+    uint16_t trendFrames = 0;
+    uint16_t trendErrors = 0;
+    uint32_t trendDropped = 0;    // format A block CRC errors seen
+    int16_t trendBase = -1;       // per mille, first window after a calibration
+
+    // power down between receive windows, requested by the decode stage
+    std::atomic<bool> sleepRequest{false};
+    uint32_t sleepCount = 0;
+    uint32_t sleepStart = 0;  // millis
+    uint32_t sleepTime = 0;   // in millis, total time in SLEEP
+
+    Cc1101Bus &bus;
+
+    bool waitMiso(void);
+
+    // execute a batch in one chip select window
+    // useShadow: skip writes of values the shadow copy says are set already
+    bool run(const Cc1101Batch &batch, bool useShadow = true);
+    bool isRedundant(const Cc1101Batch::Op &op);
+    void updateShadow(const Cc1101Batch::Op &op);
+
+    // spot check: add reads of a few registers to a batch, after run()
+    // configIntact() compares them with the shadow copy and returns false,
+    // if the chip lost its configuration (e.g. brown out)
+    void addSpotCheck(Cc1101Batch &batch, uint8_t *values);
+    bool configIntact(const uint8_t *values);
+    // rewrite registers that differ from the shadow copy, returns the number
+    uint8_t restoreRegisters(void);
+
+    void writeBurstReg(uint8_t regaddr, const uint8_t *buffer, uint8_t len);
+    void readBurstReg(uint8_t * buffer, uint8_t regaddr, uint8_t len);
+    void cmdStrobe(uint8_t cmd);
+    uint8_t readReg(uint8_t regaddr, uint8_t regtype);
+    uint8_t readRxBytes(bool link = false);
+    bool readFifo(uint8_t *buffer, uint16_t len);
+    void writeReg(uint8_t regaddr, uint8_t value);
+    bool initializeRegisters(void);
+    void switchProfile(RadioProfile p);
+
+    // start power on reset, chip is ready when MISO goes low
+    void reset(void);
+
+    // recover from a symptom, escalated if the last stage didn't help
+    void applyRecovery(RecoveryStage stage);
+
+    // SCAL finished, RX_FSCAL_CACHE: keep its results
+    void calibrationDone(void);
+    // RX_FSCAL_CACHE: temperature or age call for a new calibration
+    bool calibrationStale(void);
+
+    // switch state, timeout in micros (0: none)
+    void enterState(RadioState next, uint32_t timeout);
+    bool stateExpired(void);
+    void stateFailed(const char *what);
+
+    // go IDLE, flush fifo and (re)start receiver
+    void startReceiver(void);
+    void abortFrame(void);
+    // drop the frame being read as 'why' and restart the receiver
+    void dropFrame(WakeupClass why);
+
+    // receive a wmbus frame
+    void receive(void); // read frame from CC1101 into the frame queue
+#if RX_STREAMING
+    bool receiveChunk(void); // drain fifo while frame is arriving
+    uint8_t headerLength(void); // bytes up to the L-field
+    uint16_t frameLength(void); // from the header, 0 if invalid
+#else
+    bool receiveFrame(void); // drain fifo after end of frame
+#endif
+#if RX_CONTINUOUS
+    void rearmReceiver(void); // back to infinite length and frame start threshold
+#endif
+    void printStatus(uint8_t marcState, uint8_t rxBytes, uint8_t rssi);
+
+    // link quality of the frame being read, latched in one batch
+    uint8_t linkRegs[3]; // RSSI, LQI, FREQEST
+    void addLinkStatus(Cc1101Batch &batch);
+    void setLinkStatus(RawFrame *frame);
+
+    // sync word time of the frame being read, 'received' bytes are in the fifo
+    uint32_t frameSyncTime(uint8_t received);
+
+    // static ISR calls instanceISR via this pointer
+    IRAM_ATTR static void cc1101Isr(void *p);
+    IRAM_ATTR void instanceCC1101Isr(void);
+    IRAM_ATTR static void syncIsr(void *p);
+
+#if defined(ESP32)
+    // tick() runs in its own task, independent of WiFi/MQTT in loop()
+    TaskHandle_t radioTaskHandle = nullptr;
+    static void radioTask(void *p);
+#endif
+
+  public:
+    Cc1101Radio(Cc1101Bus &bus);
+
+    // setup SPI, GDO0 interrupt and start the radio
+    void begin(void);
+
+    // runs the radio state machine and captures frames
+    // on ESP32 this is done by the radio task, otherwise call it frequently
+    void tick(void);
+
+    // full reset and reconfiguration, done asynchronously by tick()
+    void restart(void);
+
+    // graduated recovery, done by tick(): 'stage', or the next one if the
+    // last recovery didn't bring back any frame, a frame in progress is dropped
+    // the state machine requests stages itself on symptoms it finds
+    // (MARCSTATE, FIFO overflow, lost configuration, state timeouts)
+    void recover(RecoveryStage stage = RECOVER_RESTORE);
+
+    // check MARCSTATE, FIFO and configuration now instead of within 10 s,
+    // recovers only if there is a symptom (watchdog without frames)
+    void checkHealth(void) { checkRequest = true; }
+
+    const RecoveryStats &getRecoveryStats(RecoveryStage stage) { return recovery[stage]; }
+    static const char *stageName(RecoveryStage stage);
+
+    // counters and histograms of all stages as JSON, returns the length like snprintf
+    int recoveryToJson(char *buf, size_t len) const;
+
+    // recalibrate the synthesizer between frames, done by tick()
+    void calibrate(void) { calibrateRequest = true; }
+
+    // decode stage: CRC check of a frame received by this radio, any meter
+    // failures are counted in the wakeup statistics, with RX_FSCAL_CACHE
+    // a rising error rate asks for a new calibration
+    void frameChecked(bool valid);
+
+    // temperature near the CC1101 in degrees C, a change of FSCAL_TEMP_DELTA
+    // since the last calibration asks for a new one
+    void setTemperature(int16_t celsius) { temperature = celsius; }
+
+    uint32_t getCalibrations(void) { return calibrations; }
+
+    const WakeupStats &getWakeupStats(void) { return wakeups; }
+    uint32_t getInterrupts(void) { return gdo0Interrupts; }
+    static const char *wakeupName(WakeupClass c);
+
+    // wakeups per class, GDO0 interrupts and the cost of noise as JSON
+    int wakeupsToJson(char *buf, size_t len) const;
+
+    // power down the chip after the current frame, until wake()
+    // TEST2..TEST0 are restored and the synthesizer recalibrated (or its
+    // cached calibration written back) on wake up
+    void sleep(void) { sleepRequest = true; }
+    void wake(void) { sleepRequest = false; }
+    uint32_t getSleepTime(void) { return sleepTime; }
+
+    // true, while the state machine waits for the chip
+    bool isBusy(void);
+
+    RadioState getState(void) { return state; }
+
+    // true, if frames carry exact sync word timestamps (GDO2 connected)
+    bool hasSyncTimestamps(void) { return gdo2Attached; }
+
+    // switch to another RF profile, done by tick() between frames, only
+    // the registers that differ are written
+    void setProfile(RadioProfile p);
+    RadioProfile getProfile(void) { return profile; }
+    static const char *profileName(RadioProfile p);
+
+    // frequency correction in FSCTRL0 steps (Fxosc/2^14), applied by tick()
+    // between frames with a receiver restart, kept over resets
+    void setFreqOffset(int8_t steps) { freqOffsetRequest = steps; }
+    int8_t getFreqOffset(void) { return freqOffset; }
+
+    // received frames, consumer side
+    FrameQueue<RawFrame, FRAME_QUEUE_SIZE> &frames(void) { return frameQueue; }
+
+    const TimeStats &getDrainTime(void) { return drainTime; }
+    const TimeStats &getBlindTime(void) { return blindTime; }
+    const TimeStats &getConfigTime(void) { return configTime; }
+    const SpiStats &getSpiStats(void) { return spiStats; }
+
+    static int16_t rssiToDbm(uint8_t rssi) { return (rssi >= 128) ? (rssi - 256) / 2 - 74 : rssi / 2 - 74; }
+};
+
+#endif // _CC1101RADIO_H_
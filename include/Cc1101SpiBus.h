@@ -0,0 +1,53 @@
+#ifndef __CC1101SPIBUS_H__
+#define __CC1101SPIBUS_H__
+
+#include <Arduino.h>
+#include <SPI.h>
+#if defined(ESP32)
+#include <freertos/semphr.h>
+#endif
+#include "Cc1101Bus.h"
+
+#define CC1101_NO_PIN 0xFF // for pins that aren't connected
+
+// GDO2 is optional, it gives exact sync word timestamps
+#ifndef CC1101_GDO2
+#define CC1101_GDO2 CC1101_NO_PIN
+#endif
+
+// CC1101 attached to the hardware SPI, chip select and GDO0 on GPIOs
+// several CC1101 can share the SPI bus, each with its own chip select and
+// GDO pins; only one of them is selected at a time
+class Cc1101SpiBus : public Cc1101Bus
+{
+  private:
+    static Cc1101SpiBus *volatile owner; // chip selected on the shared bus
+#if defined(ESP32)
+    static SemaphoreHandle_t lock;       // radio tasks of several chips
+#endif
+    bool started = false;
+    uint8_t csPin;
+    uint8_t misoPin;
+    uint8_t mosiPin;
+    uint8_t sckPin;
+    uint8_t gdo0Pin;
+    uint8_t gdo2Pin;
+
+  public:
+    Cc1101SpiBus(uint8_t cs, uint8_t miso, uint8_t mosi, uint8_t sck, uint8_t gdo0,
+                 uint8_t gdo2 = CC1101_NO_PIN);
+
+    void begin(void) override;
+    void select(void) override;
+    void deselect(void) override;
+    bool misoLow(void) override;
+    bool available(void) override;
+    uint8_t transfer(uint8_t value) override;
+    void resetPins(void) override;
+    void attachGdo0(void (*isr)(void *), void *arg, int mode) override;
+    void detachGdo0(void) override;
+    bool attachGdo2(void (*isr)(void *), void *arg, int mode) override;
+    void detachGdo2(void) override;
+};
+
+#endif // __CC1101SPIBUS_H__
@@ -0,0 +1,39 @@
+#ifndef __DECODER3OF6_H__
+#define __DECODER3OF6_H__
+
+#include <Arduino.h>
+
+// WMBus mode T/S 3-out-of-6 line coding (EN 13757-4): each byte is sent
+// as two 6 bit codes, high nibble first, 12 coded bits per byte
+
+// streaming decoder, takes the coded bytes in chunks as they come out of
+// the RX FIFO. The output never overtakes the input, so a frame can be
+// decoded in place (out == first coded byte).
+class Decoder3of6
+{
+  private:
+    uint8_t *out = nullptr;
+    uint16_t capacity = 0;
+    uint16_t pos = 0;      // bytes decoded
+    uint32_t bits = 0;     // coded bits not decoded yet
+    uint8_t bitCount = 0;
+    uint16_t errors = 0;   // invalid codes
+
+    void put(uint8_t high, uint8_t low);
+
+  public:
+    // start a frame, decoded bytes go to 'buffer'
+    void begin(uint8_t *buffer, uint16_t size);
+
+    // decode the next chunk, returns false if it had an invalid code
+    // (the nibble decodes as 0 and the frame is best dropped)
+    bool feed(const uint8_t *in, uint16_t len);
+
+    uint16_t size(void) const { return pos; }
+    uint16_t errorCount(void) const { return errors; }
+};
+
+// decodes 'len' bytes at once, returns false on an invalid code
+bool decode3of6(const uint8_t *in, uint8_t *out, uint16_t len);
+
+#endif // __DECODER3OF6_H__
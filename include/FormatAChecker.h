@@ -0,0 +1,47 @@
+#ifndef __FORMATACHECKER_H__
+#define __FORMATACHECKER_H__
+
+#include <Arduino.h>
+#include "utils.h"
+
+// WMBus frame format A (EN 13757-4): the L-field counts the data bytes
+// only, a CRC follows the first block (L-field .. A-field, 10 bytes) and
+// every following block of 16 bytes, the last one may be shorter
+
+// streaming block checker, takes the frame bytes in chunks as they come
+// out of the RX FIFO (or the 3-out-of-6 decoder). The CRC runs along
+// with each chunk, a block is checked as soon as its CRC is in, the CRCs
+// are removed in place, so the frame ends up as L-field + data without a
+// second buffer or a second pass.
+class FormatAChecker
+{
+  private:
+    uint8_t *buf = nullptr;
+    uint16_t in = 0;        // bytes fed
+    uint16_t out = 0;       // data bytes kept, CRCs removed
+    uint16_t total = 0;     // data bytes incl. L-field, 0 until the L-field is in
+    uint8_t blockLeft = 0;  // data bytes missing in the current block
+    uint8_t crcSeen = 0;    // CRC bytes of the current block
+    uint16_t crc = 0;       // received CRC of the current block
+    uint16_t calc = 0;      // CRC register over the data bytes of the current block
+    uint8_t blocks = 0;     // blocks checked
+    bool done = false;      // last block checked
+
+    void nextBlock(void);
+
+  public:
+    // start a frame, 'buffer' gets the L-field first
+    void begin(uint8_t *buffer);
+
+    // the next 'len' bytes are in the buffer behind the ones fed so far
+    // returns false on a block CRC error, the frame is best dropped
+    bool feed(uint16_t len);
+
+    // all blocks received and checked
+    bool complete(void) const { return done; }
+
+    uint16_t size(void) const { return out; }
+    uint8_t blockCount(void) const { return blocks; }
+};
+
+#endif // __FORMATACHECKER_H__
@@ -0,0 +1,96 @@
+#ifndef __FRAMEMERGER_H__
+#define __FRAMEMERGER_H__
+
+#include <Arduino.h>
+#include "Cc1101Radio.h"
+
+// receivers whose frames can be merged
+#ifndef MERGE_RADIOS
+#define MERGE_RADIOS 4
+#endif
+
+// micros a frame waits for the copies of the other receivers, counted from
+// when it is at the head of its queue
+#ifndef MERGE_HOLD
+#define MERGE_HOLD 10000UL
+#endif
+
+// micros between the sync words of two copies of the same telegram
+#ifndef MERGE_WINDOW
+#define MERGE_WINDOW 50000UL
+#endif
+
+// telegrams passed on, for copies that arrive after the hold time
+#ifndef MERGE_RECENT
+#define MERGE_RECENT 8
+#endif
+
+// diversity statistics of one receiver
+struct MergeStats
+{
+  uint32_t frames = 0;     // frames taken from its queue
+  uint32_t best = 0;       // copies passed on, the best RSSI of all copies
+  uint32_t only = 0;       // telegrams no other receiver had
+  uint32_t duplicates = 0; // copies dropped, another one was better
+};
+
+// merge stage for diversity reception with several CC1101: takes the
+// frames of all receivers in the order of their sync words and passes
+// a telegram on only once, the copy with the best RSSI
+// telegrams are told apart by meter ID and access number, frames that
+// fail the CRC are passed on as they are
+class FrameMerger
+{
+  public:
+    typedef FrameQueue<RawFrame, FRAME_QUEUE_SIZE> Queue;
+
+  private:
+    struct Key
+    {
+      uint32_t id = 0;         // A-field ID
+      uint16_t access = 0xFFFF; // access number, 0x100: none, 0xFFFF: unused entry
+      uint32_t syncTime = 0;
+    };
+
+    Queue *queues[MERGE_RADIOS];
+    uint8_t count = 0;
+    MergeStats stats[MERGE_RADIOS];
+
+    // key of the frame at the head of each queue
+    RawFrame *keyFrame[MERGE_RADIOS] = {};
+    Key keys[MERGE_RADIOS];
+    bool keyValid[MERGE_RADIOS] = {};
+
+    int8_t selected = -1;     // queue of the frame returned by front()
+    bool waiting = false;     // a telegram waits for its copies
+    Key waitKey;
+    uint32_t waitStart = 0;   // micros
+    bool copies = false;      // another receiver had the waiting telegram
+
+    Key recent[MERGE_RECENT]; // ring, telegrams passed on
+    uint8_t recentPos = 0;
+
+    static bool keyOf(RawFrame *frame, Key &key);
+    static bool sameTelegram(const Key &a, const Key &b);
+    bool headKey(uint8_t i, Key &key);
+    int8_t oldest(void);
+    void release(uint8_t i); // pop the head of queue 'i'
+
+  public:
+    // add the queue of a receiver, returns false if there are too many
+    bool add(Queue &queue);
+
+    // next frame to decode, nullptr if there is none or it still waits
+    // for the copies of the other receivers; 'now' in micros
+    RawFrame *front(uint32_t now);
+
+    // release the frame returned by front()
+    void pop(void);
+
+    const MergeStats &getStats(uint8_t radio) const { return stats[radio]; }
+
+    // per receiver statistics as JSON, returns the length like snprintf
+    int toJson(char *buf, size_t len) const;
+};
+
+#endif // __FRAMEMERGER_H__
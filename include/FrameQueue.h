@@ -0,0 +1,73 @@
+#ifndef __FRAMEQUEUE_H__
+#define __FRAMEQUEUE_H__
+
+#include <Arduino.h>
+#include <atomic>
+
+// fixed capacity, lock-free queue for exactly one producer and one consumer
+// producer: reserve() a slot, fill it in place, commit() it
+// consumer: front() to access the oldest entry, pop() to release it
+template <typename T, uint8_t N>
+class FrameQueue
+{
+  static_assert(N > 0 && N <= 128 && (N & (N - 1)) == 0, "capacity must be a power of 2");
+
+  private:
+    T slots[N];
+    std::atomic<uint8_t> head{0}; // free running, written by producer only
+    std::atomic<uint8_t> tail{0}; // free running, written by consumer only
+    uint8_t highWater = 0;        // max fill level seen
+    uint32_t drops = 0;           // reserve() calls on a full queue
+
+  public:
+    // producer: slot to fill, nullptr if the queue is full
+    // calling it again before commit() returns the same slot
+    T *reserve(void)
+    {
+      uint8_t h = head.load(std::memory_order_relaxed);
+      if ((uint8_t)(h - tail.load(std::memory_order_acquire)) >= N)
+      {
+        drops++;
+        return nullptr;
+      }
+      return &slots[h & (N - 1)];
+    }
+
+    // producer: hand the reserved slot over to the consumer
+    void commit(void)
+    {
+      uint8_t h = head.load(std::memory_order_relaxed) + 1;
+      head.store(h, std::memory_order_release);
+
+      uint8_t used = h - tail.load(std::memory_order_relaxed);
+      if (used > highWater) highWater = used;
+    }
+
+    // consumer: oldest entry, nullptr if the queue is empty
+    T *front(void)
+    {
+      uint8_t t = tail.load(std::memory_order_relaxed);
+      if (t == head.load(std::memory_order_acquire))
+      {
+        return nullptr;
+      }
+      return &slots[t & (N - 1)];
+    }
+
+    // consumer: release the entry returned by front()
+    void pop(void)
+    {
+      tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    uint8_t size(void) const
+    {
+      return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+    }
+
+    uint8_t capacity(void) const { return N; }
+    uint8_t highWaterMark(void) const { return highWater; }
+    uint32_t dropCount(void) const { return drops; }
+};
+
+#endif // __FRAMEQUEUE_H__
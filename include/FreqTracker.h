@@ -0,0 +1,59 @@
+#ifndef __FREQTRACKER_H__
+#define __FREQTRACKER_H__
+
+#include <Arduino.h>
+
+// good frames averaged for one correction step
+#ifndef AFC_WINDOW
+#define AFC_WINDOW 8
+#endif
+
+// minimum deviation of the average from the current correction,
+// in FREQEST/FSCTRL0 steps (Fxosc/2^14 = 1.59 kHz)
+#ifndef AFC_THRESHOLD
+#define AFC_THRESHOLD 2
+#endif
+
+// maximum correction in steps, about +-76 kHz
+#ifndef AFC_LIMIT
+#define AFC_LIMIT 48
+#endif
+
+// closed loop frequency correction for the CC1101
+// FREQEST of each good frame is the offset left over with the FSCTRL0
+// value the frame was received with, their sum is the real offset of the
+// meter. Once the average of AFC_WINDOW frames is off the current
+// correction by AFC_THRESHOLD steps, the correction moves there.
+// CRC errors are counted per correction, to see its effect.
+class FreqTracker
+{
+  private:
+    int16_t sum = 0;        // real offsets of the current window
+    uint8_t count = 0;
+    int8_t offset = 0;      // current correction, FSCTRL0
+    uint32_t corrections = 0;
+
+    uint32_t good = 0;      // frames since the last correction
+    uint32_t bad = 0;       // CRC errors since the last correction
+    uint16_t prevErrorRate = 0; // per mille, before the last correction
+
+  public:
+    // good frame, freqEst measured while FSCTRL0 was 'applied'
+    // returns true, if the correction changed
+    bool add(int8_t freqEst, int8_t applied);
+
+    // frame of the meter with a CRC error
+    void crcError(void) { bad++; }
+
+    int8_t getOffset(void) const { return offset; }
+    int32_t getOffsetHz(void) const { return (int32_t)offset * 26000000L / 16384; }
+    uint32_t getCorrections(void) const { return corrections; }
+
+    // CRC errors per 1000 frames since the last correction, and before it
+    uint16_t errorRate(void) const { return good + bad ? bad * 1000UL / (good + bad) : 0; }
+    uint16_t prevRate(void) const { return prevErrorRate; }
+
+    int toJson(char *buf, size_t len) const;
+};
+
+#endif // __FREQTRACKER_H__
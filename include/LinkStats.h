@@ -0,0 +1,73 @@
+#ifndef __LINKSTATS_H__
+#define __LINKSTATS_H__
+
+#include <Arduino.h>
+
+// frames per meter the rolling histograms are built from
+#ifndef LINK_WINDOW
+#define LINK_WINDOW 32
+#endif
+
+// meters tracked, the one not heard for the longest time gets replaced
+#ifndef LINK_METERS
+#define LINK_METERS 8
+#endif
+
+#define LINK_BUCKETS      8
+#define LINK_RSSI_MIN     -120 // dBm, lower bound of the first RSSI bucket
+#define LINK_RSSI_STEP    10   // dB per RSSI bucket
+#define LINK_LQI_STEP     16   // per LQI bucket, LQI is 0..127
+
+// link quality of a single frame
+struct LinkSample
+{
+  int8_t rssi;     // dBm
+  uint8_t lqi;     // lower is better
+  int8_t freqEst;  // FREQEST
+};
+
+// rolling link quality of one meter, over the last LINK_WINDOW frames
+class LinkStats
+{
+  private:
+    LinkSample samples[LINK_WINDOW];
+    uint8_t pos = 0;   // next sample to overwrite
+    uint8_t used = 0;  // valid samples
+
+  public:
+    uint32_t id = 0;       // A-field ID, 0: unused
+    uint32_t frames = 0;   // total frames, not only the window
+    uint32_t lastSeen = 0; // millis
+
+    void clear(uint32_t newId);
+    void add(const LinkSample &s);
+
+    // histograms over the window, LINK_BUCKETS entries each
+    // RSSI: LINK_RSSI_STEP dB per bucket from LINK_RSSI_MIN, LQI: LINK_LQI_STEP per bucket
+    // first and last bucket include everything below/above
+    void rssiHistogram(uint8_t *buckets) const;
+    void lqiHistogram(uint8_t *buckets) const;
+
+    int16_t avgRssi(void) const;
+    uint8_t avgLqi(void) const;
+    int8_t avgFreqEst(void) const;
+
+    // JSON object with averages and histograms, returns length like snprintf
+    int toJson(char *buf, size_t len) const;
+};
+
+// link statistics of all meters heard, fixed size, no heap
+class LinkTable
+{
+  private:
+    LinkStats meters[LINK_METERS];
+
+  public:
+    // add a sample for the meter, takes over the oldest entry for a new meter
+    LinkStats &update(uint32_t id, const LinkSample &s, uint32_t now);
+
+    uint8_t size(void) const { return LINK_METERS; }
+    const LinkStats &operator[](uint8_t i) const { return meters[i]; }
+};
+
+#endif // __LINKSTATS_H__
@@ -0,0 +1,130 @@
+#ifndef __METERREGISTRY_H__
+#define __METERREGISTRY_H__
+
+#include <Arduino.h>
+#include <Crypto.h>
+#include <AES.h>
+#include <CTR.h>
+
+// meters we can have the key of
+#ifndef METER_MAX
+#if defined(ESP32)
+#define METER_MAX 200
+#else
+#define METER_MAX 8
+#endif
+#endif
+
+// meters with a fully expanded key schedule (AES128, 176 bytes each),
+// the ones with the most frames lately. The others expand their key again
+// for each block (AESSmall128, 16 bytes more than the key).
+// 0: all meters small, METER_MAX: all expanded
+#ifndef METER_HOT
+#if defined(ESP32)
+#define METER_HOT 16
+#else
+#define METER_HOT 2
+#endif
+#endif
+
+// frames after which the frame counts of all meters are halved, so a
+// meter not heard anymore loses its expanded key schedule
+#ifndef METER_HEAT_DECAY
+#define METER_HEAT_DECAY 256
+#endif
+
+#define METER_COLD 0xFFFF
+
+static_assert(METER_HOT < METER_COLD, "METER_HOT too big, METER_COLD marks a meter without one");
+
+// values of the last frame decrypted
+struct MeterState
+{
+  uint32_t totalWater = 0;  // liters
+  uint32_t targetWater = 0; // liters, at the last target date
+  uint8_t flowTemp = 0;     // °C
+  uint8_t ambientTemp = 0;  // °C
+  uint8_t infoCodes = 0;
+  uint32_t frames = 0;      // frames decrypted
+  uint32_t lastSeen = 0;    // millis
+
+  // JSON object, returns length like snprintf
+  int toJson(char *buf, size_t len) const;
+};
+
+// a meter we have the key of
+struct MeterEntry
+{
+  uint32_t id = 0;    // A-field ID, 0: unused slot
+  uint8_t key[16];
+  AESSmall128 cipher; // key schedule, set up once
+  MeterState state;
+  uint16_t hot = METER_COLD; // expanded key schedule in use, METER_COLD: none
+  uint8_t heat = 0;          // frames lately, see METER_HEAT_DECAY
+};
+
+// use of the expanded key schedules
+struct KeyCacheStats
+{
+  uint32_t hot = 0;        // frames decrypted with an expanded key schedule
+  uint32_t cold = 0;       // frames decrypted with the small one
+  uint32_t expansions = 0; // key schedules expanded for a meter getting hot
+};
+
+// CTR mode on the key schedule of any meter, nothing to set up per frame
+class MeterCipher : public CTRCommon
+{
+  public:
+    void use(BlockCipher *cipher) { setBlockCipher(cipher); }
+};
+
+// smallest power of 2 with room for twice 'n' meters
+constexpr uint16_t meterSlots(uint16_t n, uint16_t s = 1)
+{
+  return s >= 2 * n ? s : meterSlots(n, 2 * s);
+}
+
+// meters by A-field ID, no heap: open addressing with linear probing in
+// a table of IDs, at most half full, which points into the entries.
+// Meters are added at startup and never removed, so a lookup ends at the
+// meter or at the first free slot.
+class MeterRegistry
+{
+  private:
+    static constexpr uint16_t SLOTS = meterSlots(METER_MAX);
+
+    uint32_t ids[SLOTS] = {};  // 0: free slot
+    uint16_t index[SLOTS];     // entry of the ID
+    MeterEntry entries[METER_MAX];
+    uint16_t count = 0;
+    uint16_t maxProbes = 0;    // longest probe sequence, bounds every lookup
+
+#if METER_HOT
+    AES128 hotCiphers[METER_HOT];
+    MeterEntry *hotOwner[METER_HOT] = {};
+#endif
+    uint16_t heatFrames = 0;   // frames since the last decay
+    KeyCacheStats keyStats;
+
+    static uint16_t home(uint32_t id);
+
+  public:
+    // false if the registry is full or 'id' is 0, a known meter gets the new key
+    bool add(uint32_t id, const uint8_t *key);
+
+    // nullptr for a meter we don't have the key of
+    MeterEntry *find(uint32_t id);
+
+    // key schedule to decrypt a frame of 'meter' with, the expanded one
+    // if the meter is hot, it may take over the one of a colder meter
+    BlockCipher *cipher(MeterEntry &meter);
+
+    uint16_t size(void) const { return count; }
+    uint16_t capacity(void) const { return METER_MAX; }
+    uint16_t slots(void) const { return SLOTS; }
+    uint16_t getMaxProbes(void) const { return maxProbes; }
+    const KeyCacheStats &getKeyStats(void) const { return keyStats; }
+    MeterEntry &operator[](uint16_t i) { return entries[i]; }
+};
+
+#endif // __METERREGISTRY_H__
@@ -0,0 +1,78 @@
+#ifndef __MODESCHEDULER_H__
+#define __MODESCHEDULER_H__
+
+#include <Arduino.h>
+#include "Cc1101Radio.h"
+#include "RxScheduler.h"
+
+// profiles the receiver cycles through
+#ifndef RX_MODES
+#define RX_MODES PROFILE_C1, PROFILE_T1
+#endif
+
+// micros per profile on average while no learned window is due, the turns
+// vary between half and one and a half of it, so a meter's interval can't
+// stay in step with them
+#ifndef RX_MODE_DWELL
+#define RX_MODE_DWELL 2000000UL
+#endif
+
+// meters whose transmit times are learned, the one not heard for the
+// longest time gets replaced
+#ifndef RX_MODE_METERS
+#define RX_MODE_METERS 8
+#endif
+
+// capture statistics of one profile
+struct ModeStats
+{
+  uint32_t frames = 0;       // valid frames received
+  uint32_t listenMillis = 0; // time the profile was active
+  uint32_t windows = 0;      // learned windows opened, all meters
+  uint32_t misses = 0;       // learned windows without a frame
+};
+
+// time-sliced reception of several WMBus modes with one CC1101
+// learns the transmit times of each meter per profile (RxScheduler) and
+// switches to a meter's profile while its window is open, otherwise the
+// profiles take turns for RX_MODE_DWELL each, to find new meters
+class ModeScheduler
+{
+  private:
+    struct Meter
+    {
+      uint32_t id = 0;       // A-field ID, 0: unused
+      RadioProfile profile;
+      uint32_t lastSeen = 0; // micros
+      RxScheduler timing;
+    };
+
+    static const RadioProfile modes[];
+    static const uint8_t modeCount;
+
+    Meter meters[RX_MODE_METERS];
+    ModeStats stats[PROFILE_COUNT];
+    uint8_t turn = 0;          // index into modes, round robin
+    RadioProfile active;
+    uint32_t turnStart = 0;    // micros
+    uint32_t dwell = RX_MODE_DWELL; // micros of the current turn
+    uint32_t seed = 0x2545F491;
+    uint32_t lastSelect = 0;   // micros
+    uint32_t listenMicros = 0; // not yet added to listenMillis
+
+  public:
+    ModeScheduler(void);
+
+    // valid frame of meter 'id', received with profile 'p'
+    void frame(uint32_t id, RadioProfile p, uint32_t syncTime);
+
+    // profile the receiver should use at 'now' (micros)
+    RadioProfile select(uint32_t now);
+
+    const ModeStats &getStats(RadioProfile p) const { return stats[p]; }
+
+    // frames per hour of listening, per profile, as JSON
+    int toJson(char *buf, size_t len) const;
+};
+
+#endif // __MODESCHEDULER_H__
@@ -0,0 +1,62 @@
+#ifndef __RXSCHEDULER_H__
+#define __RXSCHEDULER_H__
+
+#include <Arduino.h>
+
+// consistent frames needed before the receiver is switched off between windows
+#ifndef RX_WINDOW_LEARN
+#define RX_WINDOW_LEARN 4
+#endif
+
+// micros the window opens before and closes after the expected sync word,
+// at least, covers wake up, calibration and loop latency
+#ifndef RX_WINDOW_MARGIN
+#define RX_WINDOW_MARGIN 20000UL
+#endif
+
+#define RX_WINDOW_JITTER    4           // margin in multiples of the learned jitter
+#define RX_WINDOW_FRAME     30000UL     // micros from sync word until the frame is decoded
+#define RX_WINDOW_MAX       120000000UL // micros, longer gaps restart learning
+#define RX_WINDOW_GAIN      4           // weight of the learned phase and jitter
+#define RX_WINDOW_DRIFT     16          // weight of the learned interval
+
+// learns the transmit interval and jitter of one meter from the sync word
+// times of its frames and predicts when it sends next
+// between windows the radio can be powered down, a window without a frame
+// falls back to continuous RX until the meter is heard again
+class RxScheduler
+{
+  private:
+    uint32_t anchor = 0;    // predicted sync word micros of the last frame
+    uint32_t interval = 0;  // learned transmit interval, micros, 0: unknown
+    uint32_t jitter = 0;    // average deviation from the interval, micros
+    uint8_t consistent = 0; // frames that matched the interval
+    bool locked = false;    // windows are used
+    bool listening = true;  // what listen() returned last
+    uint32_t changed = 0;   // micros of the last listening change
+
+    uint32_t windows = 0;   // windows opened
+    uint32_t misses = 0;    // windows without a frame
+    uint32_t sleepMillis = 0; // total time the receiver wasn't needed
+
+    uint32_t margin(void) const;
+    void setListening(bool listen, uint32_t now);
+
+  public:
+    // frame of the meter, sync word time in micros
+    void frame(uint32_t syncTime);
+
+    // true, if the receiver must be on at 'now' (micros)
+    bool listen(uint32_t now);
+
+    bool isLocked(void) const { return locked; }
+    uint32_t getInterval(void) const { return interval; }
+    uint32_t getJitter(void) const { return jitter; }
+    uint32_t getWindows(void) const { return windows; }
+    uint32_t getMisses(void) const { return misses; }
+    uint32_t getSleepTime(void) const { return sleepMillis; }
+
+    int toJson(char *buf, size_t len) const;
+};
+
+#endif // __RXSCHEDULER_H__
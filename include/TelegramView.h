@@ -0,0 +1,43 @@
+#ifndef __TELEGRAMVIEW_H__
+#define __TELEGRAMVIEW_H__
+
+#include <Arduino.h>
+
+// decrypted application data of a Multical21 frame, read where it was
+// decrypted, in the frame buffer, nothing is copied
+// compact frames (CI 0x79) and long frames (0x78) have the values at
+// different offsets
+class TelegramView
+{
+  private:
+    const uint8_t *data;
+    uint8_t len;
+
+    uint32_t u32(uint8_t pos) const
+    {
+      return data[pos] | data[pos + 1] << 8 | data[pos + 2] << 16 | (uint32_t)data[pos + 3] << 24;
+    }
+
+  public:
+    TelegramView(const uint8_t *plaintext, uint8_t length)
+      : data (plaintext)
+      , len  (length)
+    {
+    }
+
+    bool isLong(void) const { return data[2] == 0x78; }
+
+    // long enough for all values
+    bool valid(void) const { return len > 2 && len > (isLong() ? 25 : 18); }
+
+    uint32_t totalWater(void) const { return u32(isLong() ? 10 : 9); }   // liters
+    uint32_t targetWater(void) const { return u32(isLong() ? 16 : 13); } // liters
+    uint8_t flowTemp(void) const { return data[isLong() ? 22 : 17]; }    // °C
+    uint8_t ambientTemp(void) const { return data[isLong() ? 25 : 18]; } // °C
+    uint8_t infoCodes(void) const { return data[isLong() ? 6 : 7]; }
+
+    const uint8_t *bytes(void) const { return data; }
+    uint8_t size(void) const { return len; }
+};
+
+#endif // __TELEGRAMVIEW_H__
@@ -12,10 +12,40 @@
 #define MQTT_atemp "/ambienttemp"
 #define MQTT_info "/infocode"
 
+// 1: drain the CC1101 FIFO while the frame is arriving (frames up to 255 bytes)
+// 0: read the frame after FIFO overflow (frames up to 61 bytes)
+#define RX_STREAMING 1
+// 1: CC1101 stays in RX between frames (needs RX_STREAMING)
+#define RX_CONTINUOUS 1
+// 1: calibrate the synthesizer once and write the results back before RX,
+// again only when the temperature or the CRC errors ask for it
+#define RX_FSCAL_CACHE 0
+// sync word gating on a noisy band: preamble quality 4 * RX_PQT (0: off),
+// carrier sense 1: +6 dB, 2: +10 dB, 3: +14 dB above the noise (0: off)
+#define RX_PQT 0
+#define RX_CS_REL 0
+// CC1101 register profile: PROFILE_C1 or PROFILE_C1_NARROW (more sensitive)
+#define RADIO_PROFILE PROFILE_C1
+// 1: power the CC1101 down between the meter's transmissions, once its
+// interval is learned (other meters are only heard while the receiver is on)
+#define RX_WINDOWING 0
+// 1: take turns between the modes in RX_MODES, learning when each meter
+// sends (needs RX_STREAMING, not together with RX_WINDOWING)
+#define RX_MULTIMODE 0
+#define RX_MODES PROFILE_C1, PROFILE_T1
+
 // ask your water supplier for your personal encryption key 
 #define ENCRYPTION_KEY      0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF
 // serial number is printed on your multical21
 #define SERIAL_NUMBER       0x12, 0x34, 0x56, 0x78
+// more meters to decrypt, { serial number, { key } } each, their values are
+// published as JSON to MQTT_PREFIX "/meter/<serial number>", at most
+// METER_MAX - 1 of them (7 on the ESP8266, 199 on the ESP32)
+/*
+#define METERS \
+  { 0x12345679, { 0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF } }, \
+  { 0x12345680, { 0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF } }
+*/
 
 // WIFI configuration, supports more than one WIFI, first found first served
 // if you dont use MQTT, leave broker/user/pass empty ("")
@@ -45,8 +75,9 @@ std::vector<CREDENTIAL> const credentials = {
 // MISO  => D6
 // SCK   => D5
 // GD0   => D2  A valid interrupt pin for your platform (defined below this)
-// GD2   => not connected 
+// GD2   => D1  optional, exact sync word timestamps, uncomment CC1101_GDO2 if connected
   #define CC1101_GDO0         D2   // GDO0 input interrupt pin
+//  #define CC1101_GDO2         D1   // GDO2 sync word interrupt pin
   #define PIN_LED_BUILTIN     D4
 #elif defined(ESP32)
 // Attach CC1101 pins to ESP32 SPI pins
@@ -57,11 +88,18 @@ std::vector<CREDENTIAL> const credentials = {
 // MISO  => 19
 // SCK   => 18
 // GD0   => 32  any valid interrupt pin for your platform will do
-// GD2   => not connected 
+// GD2   => 33  optional, exact sync word timestamps, uncomment CC1101_GDO2 if connected
 
 // attach CC1101 pins to ESP32 SPI pins
 
   #define CC1101_GDO0          32
+//  #define CC1101_GDO2          33
   #define PIN_LED_BUILTIN      2
+
+// diversity reception: a second CC1101 on the same SPI bus (MOSI, MISO, SCK
+// shared), with its own CSN, GD0 and GD2, and the antenna somewhere else
+// { CSN, GD0, GD2 } per CC1101, GD2 may be CC1101_NO_PIN
+//  #define RADIO_COUNT          2
+//  #define CC1101_RADIOS        { 4, 32, 33 }, { 5, 25, 26 }
 #endif
 #endif // __CONFIG_H__
\ No newline at end of file
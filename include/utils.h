@@ -4,11 +4,66 @@
 #include <Arduino.h>
 #include <inttypes.h>
 
+// last/max/avg of a duration, e.g. micros per frame
+struct TimeStats
+{
+  uint32_t last = 0;
+  uint32_t max = 0;
+  uint32_t sum = 0;
+  uint32_t count = 0;
+
+  void add(uint32_t t)
+  {
+    last = t;
+    if (t > max) max = t;
+    sum += t;
+    count++;
+  }
+
+  uint32_t avg(void) const { return count ? sum / count : 0; }
+};
+
+// bytes per step of the table driven EN 13757 CRC: 1 (512 byte table),
+// 4 or 8 (2 or 4 KB of tables, for the host, where the cache holds them)
+#ifndef CRC_SLICE
+#if defined(ESP32) || defined(ESP8266)
+#define CRC_SLICE 1
+#else
+#define CRC_SLICE 8
+#endif
+#endif
+#if CRC_SLICE != 1 && CRC_SLICE != 4 && CRC_SLICE != 8
+#error "CRC_SLICE must be 1, 4 or 8"
+#endif
+
 void printHex(uint8_t * buf, size_t len);
 
-uint16_t crcEN13575(uint8_t *payload, uint16_t length);
+// EN 13757 CRC-16, polynomial 0x3D65, table driven
+uint16_t crcEN13575(const uint8_t *payload, uint16_t length);
+
+// the CRC register over the next 'length' bytes, without the final XOR,
+// starts with 0: crcEN13575(p, n) == (uint16_t)~crcEN13575Update(0, p, n)
+uint16_t crcEN13575Update(uint16_t crc, const uint8_t *p, uint16_t length);
+uint16_t crcEN13575Bytewise(uint16_t crc, const uint8_t *p, uint16_t length);
+#if CRC_SLICE >= 4
+uint16_t crcEN13575Slice4(uint16_t crc, const uint8_t *p, uint16_t length);
+#endif
+#if CRC_SLICE >= 8
+uint16_t crcEN13575Slice8(uint16_t crc, const uint8_t *p, uint16_t length);
+#endif
+
 uint16_t mirror(uint16_t crc, uint8_t bitnum);
+
+// generic bit by bit CRC, the reference for the table driven one
 uint16_t crcInternal(uint8_t *p, uint16_t len, uint16_t poly, uint16_t init, bool revIn, bool revOut);
+
+// coded bytes of 'len' bytes in 3-out-of-6 line coding (mode T/S)
+inline uint16_t length3of6(uint16_t len) { return (len * 3 + 1) / 2; }
+
+// frame format A: L-field + data, with a CRC after the first 10 bytes
+// and after every following 16 bytes, returns the bytes incl. CRCs
+uint16_t formatALength(uint8_t lField);
+
 void bin2hex(char *xp, uint8_t *bb, int n);
 void hex2bin(const char *in, size_t len, uint8_t *out);
 
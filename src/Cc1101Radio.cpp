@@ -0,0 +1,1531 @@
+/*
+ Copyright (C) 2020 chester4444@wolke7.net
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Cc1101Radio.h"
+
+// register values IOCFG2 (0x00) .. TEST0 (0x2E), written with one burst
+struct Cc1101Profile
+{
+  const char *name;
+  bool coded; // 3-out-of-6 line coding, frame format A
+  uint8_t regs[CC1101_CONFIG_SIZE];
+};
+
+#define CC1101_PROFILE(name, coded, mdmcfg4, mdmcfg3, deviatn) { name, coded, { \
+  CC1101_DEFVAL_IOCFG2,   CC1101_DEFVAL_IOCFG1,   CC1101_DEFVAL_IOCFG0,   CC1101_DEFVAL_FIFOTHR,  /* 0x00 */ \
+  CC1101_DEFVAL_SYNC1,    CC1101_DEFVAL_SYNC0,    CC1101_DEFVAL_PKTLEN,   CC1101_DEFVAL_PKTCTRL1, /* 0x04 */ \
+  CC1101_DEFVAL_PKTCTRL0, CC1101_DEFVAL_ADDR,     CC1101_DEFVAL_CHANNR,   CC1101_DEFVAL_FSCTRL1,  /* 0x08 */ \
+  CC1101_DEFVAL_FSCTRL0,  CC1101_DEFVAL_FREQ2,    CC1101_DEFVAL_FREQ1,    CC1101_DEFVAL_FREQ0,    /* 0x0C */ \
+  mdmcfg4,                mdmcfg3,                CC1101_DEFVAL_MDMCFG2,  CC1101_DEFVAL_MDMCFG1,  /* 0x10 */ \
+  CC1101_DEFVAL_MDMCFG0,  deviatn,                CC1101_DEFVAL_MCSM2,    CC1101_DEFVAL_MCSM1,    /* 0x14 */ \
+  CC1101_DEFVAL_MCSM0,    CC1101_DEFVAL_FOCCFG,   CC1101_DEFVAL_BSCFG,    CC1101_DEFVAL_AGCCTRL2, /* 0x18 */ \
+  CC1101_DEFVAL_AGCCTRL1, CC1101_DEFVAL_AGCCTRL0, CC1101_DEFVAL_WOREVT1,  CC1101_DEFVAL_WOREVT0,  /* 0x1C */ \
+  CC1101_DEFVAL_WORCTRL,  CC1101_DEFVAL_FREND1,   CC1101_DEFVAL_FREND0,   CC1101_DEFVAL_FSCAL3,   /* 0x20 */ \
+  CC1101_DEFVAL_FSCAL2,   CC1101_DEFVAL_FSCAL1,   CC1101_DEFVAL_FSCAL0,   CC1101_DEFVAL_RCCTRL1,  /* 0x24 */ \
+  CC1101_DEFVAL_RCCTRL0,  CC1101_DEFVAL_FSTEST,   CC1101_DEFVAL_PTEST,    CC1101_DEFVAL_AGCTEST,  /* 0x28 */ \
+  CC1101_DEFVAL_TEST2,    CC1101_DEFVAL_TEST1,    CC1101_DEFVAL_TEST0                             /* 0x2C */ \
+  } }
+
+static constexpr Cc1101Profile profiles[PROFILE_COUNT] =
+{
+  CC1101_PROFILE("C1", false, CC1101_DEFVAL_MDMCFG4, CC1101_DEFVAL_MDMCFG3, CC1101_DEFVAL_DEVIATN),
+  CC1101_PROFILE("C1 narrow", false, CC1101_NARROW_MDMCFG4, CC1101_DEFVAL_MDMCFG3, CC1101_DEFVAL_DEVIATN),
+  // same sync word: mode T preamble + sync chips end in 0x543D as well
+  CC1101_PROFILE("T1", true, CC1101_T1_MDMCFG4, CC1101_T1_MDMCFG3, CC1101_T1_DEVIATN),
+};
+
+static_assert(profiles[PROFILE_C1].regs[CC1101_TEST0] == CC1101_DEFVAL_TEST0, "profile table out of order");
+
+// registers with profile values different from their reset values,
+// a chip that reset itself silently shows up here
+static const uint8_t spotCheckRegs[CC1101_SPOT_CHECK_SIZE] =
+{
+  CC1101_IOCFG0, CC1101_SYNC1, CC1101_FREQ1, CC1101_MDMCFG4
+};
+
+// mode C frame header: preamble 0x54 0xCD (format A) or 0x54 0x3D (format B)
+// and an L-field long enough for a WMBus frame, anything else is noise
+static bool plausibleHeader(const uint8_t *header)
+{
+  return header[0] == 0x54 && (header[1] == 0xCD || header[1] == 0x3D) &&
+         header[2] >= WMBUS_MIN_LENGTH;
+}
+
+// FSCAL3..FSCAL1 hold calibration results, not what was written
+static bool isCalibrationReg(uint8_t regAddr)
+{
+  return regAddr >= CC1101_FSCAL3 && regAddr <= CC1101_FSCAL1;
+}
+
+Cc1101Radio::Cc1101Radio(Cc1101Bus &bus)
+  : bus (bus)
+{
+}
+
+// wait for MISO pulling down (chip ready)
+// gives up after MISO_TIMEOUT and schedules a reset of the chip
+bool Cc1101Radio::waitMiso(void)
+{
+  uint32_t start = micros();
+
+  while (!bus.misoLow())
+  {
+    if (micros() - start > MISO_TIMEOUT)
+    {
+      misoTimeouts++;
+      resetRequest = true;
+      return false;
+    }
+  }
+
+  return true;
+}
+
+// execute all accesses of the batch in one chip select window
+// returns false, if the chip wasn't ready (reads return 0 then)
+bool Cc1101Radio::run(const Cc1101Batch &batch, bool useShadow)
+{
+  uint32_t start = micros();
+  bool ready = batch.isValid();
+  uint8_t needed = 0;
+
+  for (uint8_t i = 0; i < batch.size(); i++)
+  {
+    if (!useShadow || !isRedundant(batch[i])) needed++;
+  }
+
+  if (ready && needed == 0)
+  {
+    skippedWrites += batch.size(); // nothing to do, no transaction at all
+    return true;
+  }
+
+  if (!ready)
+  {
+    Serial.println("Invalid SPI batch");
+  }
+  else
+  {
+    bus.select();
+    ready = waitMiso();      // Wait until MISO goes low
+  }
+
+  for (uint8_t i = 0; i < batch.size(); i++)
+  {
+    const Cc1101Batch::Op &op = batch[i];
+
+    if (!ready)
+    {
+      if (op.type == SPI_READ) *op.dst = 0;
+      if (op.type == SPI_READ_BURST) memset(op.dst, 0, op.len);
+      continue;
+    }
+
+    if (useShadow && isRedundant(op))
+    {
+      skippedWrites++;
+      continue;
+    }
+
+    uint32_t opStart = micros();
+    bus.transfer(op.header); // Send address or strobe command
+
+    switch (op.type)
+    {
+      case SPI_STROBE:
+        break;
+      case SPI_WRITE:
+        bus.transfer(op.value);
+        break;
+      case SPI_READ:
+        *op.dst = bus.transfer(0x00);
+        break;
+      case SPI_READ_BURST:
+        for (uint8_t j = 0; j < op.len; j++)
+          op.dst[j] = bus.transfer(0x00);  // address auto increments
+        break;
+      case SPI_WRITE_BURST:
+        for (uint8_t j = 0; j < op.len; j++)
+          bus.transfer(op.src[j]);
+        break;
+      default:
+        break;
+    }
+
+    updateShadow(op);
+    spiStats.count[op.type]++;
+    spiStats.opTime[op.type] += micros() - opStart;
+    spiStats.bytes += 1 + ((op.type == SPI_WRITE || op.type == SPI_READ) ? 1 : op.len);
+  }
+
+  if (batch.isValid())
+  {
+    bus.deselect();
+    spiStats.transactions++;
+    spiStats.time += micros() - start;
+  }
+
+  return ready;
+}
+
+// true, if the op writes the value the register has already
+bool Cc1101Radio::isRedundant(const Cc1101Batch::Op &op)
+{
+  return op.type == SPI_WRITE && shadowValid &&
+         op.header < CC1101_CONFIG_SIZE && shadow[op.header] == op.value;
+}
+
+// keep track of the configuration registers written
+void Cc1101Radio::updateShadow(const Cc1101Batch::Op &op)
+{
+  if (op.type == SPI_WRITE && op.header < CC1101_CONFIG_SIZE)
+  {
+    shadow[op.header] = op.value;
+  }
+  else if (op.type == SPI_WRITE_BURST)
+  {
+    uint8_t addr = op.header & 0x3F;
+    for (uint8_t j = 0; j < op.len && addr + j < CC1101_CONFIG_SIZE; j++)
+      shadow[addr + j] = op.src[j];
+  }
+}
+
+void Cc1101Radio::addSpotCheck(Cc1101Batch &batch, uint8_t *values)
+{
+  for (uint8_t i = 0; i < CC1101_SPOT_CHECK_SIZE; i++)
+    batch.read(spotCheckRegs[i], CC1101_CONFIG_REGISTER, &values[i]);
+}
+
+bool Cc1101Radio::configIntact(const uint8_t *values)
+{
+  if (!shadowValid)
+  {
+    return true; // nothing to compare with
+  }
+
+  for (uint8_t i = 0; i < CC1101_SPOT_CHECK_SIZE; i++)
+  {
+    if (values[i] != shadow[spotCheckRegs[i]]) return false;
+  }
+  return true;
+}
+
+// read all configuration registers with one burst and rewrite the ones
+// that differ from the shadow copy, in batches or as a single burst,
+// if the chip lost (nearly) everything
+uint8_t Cc1101Radio::restoreRegisters(void)
+{
+  uint8_t regs[CC1101_CONFIG_SIZE];
+  uint8_t diverged = 0;
+
+  readBurstReg(regs, CC1101_IOCFG2, CC1101_CONFIG_SIZE);
+
+  for (uint8_t i = 0; i < CC1101_CONFIG_SIZE; i++)
+  {
+    if (regs[i] != shadow[i] && !isCalibrationReg(i)) diverged++;
+  }
+
+  if (diverged > CC1101_BATCH_SIZE)
+  {
+    // the next SRX recalibrates (MCSM0.FS_AUTOCAL) or gets the cached
+    // calibration, FSCAL can be overwritten
+    run(Cc1101Batch().writeBurst(CC1101_IOCFG2, shadow, CC1101_CONFIG_SIZE), false);
+  }
+  else if (diverged)
+  {
+    Cc1101Batch batch;
+    for (uint8_t i = 0; i < CC1101_CONFIG_SIZE; i++)
+    {
+      if (regs[i] != shadow[i] && !isCalibrationReg(i))
+        batch.write(i, shadow[i]);
+    }
+    run(batch, false);
+  }
+
+  restoredRegs += diverged;
+  return diverged;
+}
+
+// write a single register of CC1101
+void Cc1101Radio::writeReg(uint8_t regAddr, uint8_t value)
+{
+  run(Cc1101Batch().write(regAddr, value));
+}
+
+// send a strobe command to CC1101
+void Cc1101Radio::cmdStrobe(uint8_t cmd)
+{
+  run(Cc1101Batch().strobe(cmd));
+}
+
+// read CC1101 register (status or configuration)
+uint8_t Cc1101Radio::readReg(uint8_t regAddr, uint8_t regType)
+{
+  uint8_t val;
+
+  run(Cc1101Batch().read(regAddr, regType, &val));
+  return val;
+}
+
+// write consecutive registers in a single transaction
+void Cc1101Radio::writeBurstReg(uint8_t regAddr, const uint8_t *buffer, uint8_t len)
+{
+  run(Cc1101Batch().writeBurst(regAddr, buffer, len));
+}
+
+// read consecutive registers or the RX fifo in a single transaction
+void Cc1101Radio::readBurstReg(uint8_t *buffer, uint8_t regAddr, uint8_t len)
+{
+  run(Cc1101Batch().readBurst(regAddr, buffer, len));
+}
+
+// start power on reset, see CC1101 datasheet 19.1.2
+// CS stays asserted, the chip is ready when it pulls MISO low
+void Cc1101Radio::reset(void)
+{
+  bus.deselect();
+  delayMicroseconds(3);
+
+  bus.resetPins(); // see CC1101 datasheet 11.3
+
+  bus.select();
+  delayMicroseconds(3);
+  bus.deselect();
+  delayMicroseconds(45); // at least 40 us
+
+  bus.select();
+
+  if (waitMiso())              // Wait until MISO goes low
+  {
+    bus.transfer(CC1101_SRES); // Send reset command strobe
+  }
+}
+
+// switch to the next state, timeout in micros (0: none)
+void Cc1101Radio::enterState(RadioState next, uint32_t timeout)
+{
+  state = next;
+  stateEntered = micros();
+  stateTimeout = timeout;
+}
+
+bool Cc1101Radio::stateExpired(void)
+{
+  return stateTimeout && (micros() - stateEntered > stateTimeout);
+}
+
+// the chip didn't reach the expected state in time
+// retry the receiver start, if that keeps failing do a full reset
+void Cc1101Radio::stateFailed(const char *what)
+{
+  timeoutCount++;
+  Serial.printf("Enter %s state failed!\n", what);
+
+  if (++retries >= MAX_RETRIES || state == RADIO_RESET_WAIT)
+  {
+    applyRecovery(RECOVER_RESET);
+  }
+  else
+  {
+    // a chip that reset itself doesn't need another reset
+    uint8_t values[CC1101_SPOT_CHECK_SIZE];
+    Cc1101Batch batch;
+    addSpotCheck(batch, values);
+    run(batch);
+    if (!configIntact(values))
+    {
+      silentResets++;
+      applyRecovery(RECOVER_RESTORE);
+    }
+    else
+    {
+      applyRecovery(RECOVER_FLUSH);
+    }
+  }
+}
+
+// drop a partially received frame
+void Cc1101Radio::abortFrame(void)
+{
+  rxFrame = nullptr; // not committed, the slot gets reused
+#if RX_STREAMING
+  rxPos = 0;
+  rxLen = 0;
+  rxStatusLen = 0;
+  rxDrainTime = 0;
+  rxFormatA = false;
+  rxBlocksFed = 0;
+  rxCrc = 0;
+  rxCrcFed = 0;
+  rxCrcEnd = 0;
+  rxCrcOk = true;
+#endif
+#if RX_CONTINUOUS
+  rxFixedLength = false;
+#endif
+}
+
+void Cc1101Radio::dropFrame(WakeupClass why)
+{
+  wakeups.count[why]++;
+#if RX_STREAMING
+  wakeups.noiseBytes += rxPos;
+  wakeups.noiseTime += rxDrainTime;
+#if DEBUG >= 1
+  Serial.printf("RX %s after %d of %d bytes, frame dropped\n", wakeupName(why), rxPos, rxLen);
+#endif
+#endif
+  startReceiver();
+}
+
+const char *Cc1101Radio::wakeupName(WakeupClass c)
+{
+  static const char *names[WAKEUP_CLASSES] = { "frame", "header", "coding", "block_crc", "truncated" };
+  return c < WAKEUP_CLASSES ? names[c] : "?";
+}
+
+// set IDLE state, flush FIFO and (re)start receiver
+// the rest is done by tick()
+void Cc1101Radio::startReceiver(void)
+{
+  blindPending = false;
+#if RX_CONTINUOUS
+  rearmReceiver();
+#endif
+  abortFrame();
+  cmdStrobe(CC1101_SIDLE); // Enter IDLE state
+  enterState(RADIO_IDLE_WAIT, IDLE_TIMEOUT);
+}
+
+void Cc1101Radio::restart(void)
+{
+  resetRequest = true;
+}
+
+void Cc1101Radio::recover(RecoveryStage stage)
+{
+  // the highest stage requested wins
+  uint8_t request = recoverRequest;
+  while (request < stage + 1 && !recoverRequest.compare_exchange_weak(request, stage + 1))
+  {
+  }
+}
+
+const char *Cc1101Radio::stageName(RecoveryStage stage)
+{
+  static const char *names[RECOVER_STAGES] = { "rx", "flush", "calibrate", "restore", "reset" };
+  return stage < RECOVER_STAGES ? names[stage] : "?";
+}
+
+void Cc1101Radio::applyRecovery(RecoveryStage stage)
+{
+  bool escalated = false;
+
+  // the last recovery brought back no frame, and the symptom is back
+  if (lastStage >= 0 && stage <= lastStage && millis() - lastRecovery < RECOVER_ESCALATE)
+  {
+    stage = (RecoveryStage)(lastStage < RECOVER_RESET ? lastStage + 1 : RECOVER_RESET);
+    escalated = true;
+  }
+
+  if (stage == RECOVER_RESTORE && !shadowValid)
+  {
+    stage = RECOVER_RESET; // configuration unknown
+  }
+
+  recovery[stage].count++;
+  if (escalated) recovery[stage].escalated++;
+  lastStage = stage;
+  lastRecovery = millis();
+  recovering = stage;
+  recoverStart = micros();
+
+  Serial.printf("Recovering CC1101: %s%s\n", stageName(stage), escalated ? " (escalated)" : "");
+
+  switch (stage)
+  {
+    case RECOVER_RX:
+      blindPending = false;
+      abortFrame();
+      // from IDLE this calibrates (MCSM0.FS_AUTOCAL), except with RX_FSCAL_CACHE:
+      // auto calibration is off and RX runs on the FSCAL values in place,
+      // escalation reaches the calibrate stage if that doesn't help
+      cmdStrobe(CC1101_SRX);
+      enterState(RADIO_RX_WAIT, RX_TIMEOUT);
+      break;
+
+    case RECOVER_FLUSH:
+      startReceiver();
+      break;
+
+    case RECOVER_CALIBRATE:
+      calibratePending = true;
+      startReceiver();
+      break;
+
+    case RECOVER_RESTORE:
+      Serial.printf("%d registers restored\n", restoreRegisters());
+      startReceiver();
+      break;
+
+    default:
+      enterState(RADIO_RESET, 0);
+      break;
+  }
+}
+
+// SCAL finished: the calibration is fresh for the CRC trend, temperature
+// and age, with RX_FSCAL_CACHE its results are written back before RX
+void Cc1101Radio::calibrationDone(void)
+{
+#if RX_FSCAL_CACHE
+  readBurstReg(fscal, CC1101_FSCAL3, sizeof(fscal));
+  fscalValid = true;
+#endif
+  calibrations++;
+  calTime = millis();
+  calTemperature = temperature;
+  trendReset = true;
+}
+
+bool Cc1101Radio::calibrationStale(void)
+{
+#if RX_FSCAL_CACHE
+  int16_t t = temperature;
+
+  if (t != FSCAL_NO_TEMPERATURE && calTemperature == FSCAL_NO_TEMPERATURE)
+  {
+    calTemperature = t; // first reading after the calibration
+  }
+
+  if (t != FSCAL_NO_TEMPERATURE && abs(t - calTemperature) >= FSCAL_TEMP_DELTA)
+  {
+    calTemperatureChanges++;
+    return true;
+  }
+
+  if (millis() - calTime > FSCAL_MAX_AGE)
+  {
+    calExpired++;
+    return true;
+  }
+#endif
+
+  return false;
+}
+
+// RX_FSCAL_CACHE: the first window after a calibration is the baseline,
+// frames of other meters count as well, they see the same synthesizer
+// format A frames with a block CRC error never get here, the radio
+// dropped them already, they count as errors of this window
+void Cc1101Radio::frameChecked(bool valid)
+{
+  if (!valid)
+  {
+    wakeups.crcErrors++;
+  }
+
+#if RX_FSCAL_CACHE
+  uint32_t dropped = wakeups.count[WAKEUP_BLOCK_CRC];
+  uint32_t blockErrors = dropped - trendDropped;
+
+  trendDropped = dropped;
+  if (trendReset.exchange(false))
+  {
+    trendFrames = 0;
+    trendErrors = 0;
+    trendBase = -1;
+    blockErrors = 0;
+  }
+
+  // a noisy night may drop more than fit, a full window closes anyway
+  if (blockErrors > FSCAL_TREND_WINDOW)
+  {
+    blockErrors = FSCAL_TREND_WINDOW;
+  }
+  trendFrames += 1 + blockErrors;
+  trendErrors += blockErrors + !valid;
+
+  if (trendFrames < FSCAL_TREND_WINDOW)
+  {
+    return;
+  }
+
+  int16_t rate = trendErrors * 1000 / trendFrames;
+  if (trendBase < 0)
+  {
+    trendBase = rate;
+  }
+  else if (rate >= trendBase + FSCAL_TREND_RISE)
+  {
+    calibrateRequest = true;
+  }
+  trendFrames = 0;
+  trendErrors = 0;
+#endif
+}
+
+void Cc1101Radio::setProfile(RadioProfile p)
+{
+#if !RX_STREAMING
+  if (p < PROFILE_COUNT && profiles[p].coded) return; // L-field must be decoded while receiving
+#endif
+  if (p < PROFILE_COUNT)
+  {
+    profileRequest = p;
+  }
+}
+
+// switch to another profile without a reset: write the registers that
+// differ from the shadow copy in IDLE, then restart the receiver
+void Cc1101Radio::switchProfile(RadioProfile p)
+{
+  const uint8_t *regs = profiles[p].regs;
+  Cc1101Batch batch;
+
+  batch.strobe(CC1101_SIDLE);
+  for (uint8_t i = 0; i < CC1101_CONFIG_SIZE; i++)
+  {
+    // keep the frequency correction and calibration results, all
+    // profiles use the same frequency
+    if (i == CC1101_FSCTRL0 || isCalibrationReg(i) || shadow[i] == regs[i])
+    {
+      continue;
+    }
+    if (batch.size() == CC1101_BATCH_SIZE)
+    {
+      run(batch);
+      batch = Cc1101Batch();
+    }
+    batch.write(i, regs[i]);
+  }
+  run(batch);
+
+  profile = p;
+  profileSwitches++;
+  startReceiver();
+}
+
+const char *Cc1101Radio::profileName(RadioProfile p)
+{
+  return p < PROFILE_COUNT ? profiles[p].name : "?";
+}
+
+bool Cc1101Radio::isBusy(void)
+{
+#if RX_STREAMING
+  return state != RADIO_RX || rxPos;
+#else
+  return state != RADIO_RX;
+#endif
+}
+
+// the radio state machine, must be called frequently
+// never waits for the chip, every state has a timeout
+void Cc1101Radio::tick(void)
+{
+  uint8_t marcState;
+
+  // another chip on the shared SPI bus holds MISO
+  if (!bus.available())
+  {
+    return;
+  }
+
+  if (resetRequest)
+  {
+    resetRequest = false;
+    enterState(RADIO_RESET, 0);
+  }
+
+  // a sleeping chip is recovered once it's awake again, a frame in
+  // progress is dropped
+  if (recoverRequest && state != RADIO_SLEEP && state != RADIO_WAKE_WAIT)
+  {
+    RecoveryStage stage = (RecoveryStage)(recoverRequest.exchange(0) - 1);
+    if (state != RADIO_RESET_WAIT)
+    {
+      applyRecovery(stage); // nothing to do while a reset is under way
+    }
+  }
+
+  // power down between receive windows, never during a frame
+  if (sleepRequest && state == RADIO_RX && !isBusy())
+  {
+    blindPending = false;
+    run(Cc1101Batch().strobe(CC1101_SIDLE).strobe(CC1101_SPWD)); // SLEEP when CS goes high
+    sleepCount++;
+    sleepStart = millis();
+    enterState(RADIO_SLEEP, 0);
+  }
+  else if (!sleepRequest && state == RADIO_SLEEP)
+  {
+    bus.select(); // wakes the chip up, MISO goes low once the crystal runs
+    enterState(RADIO_WAKE_WAIT, WAKE_TIMEOUT);
+  }
+
+  // another profile, between frames
+  if (profileRequest != profile && state == RADIO_RX && !isBusy())
+  {
+    switchProfile(profileRequest);
+  }
+
+  switch (state)
+  {
+    case RADIO_RESET:
+      Serial.println("Resetting CC1101...");
+      resetCount++;
+      shadowValid = false; // registers go back to reset values
+      abortFrame();
+      reset();
+      enterState(RADIO_RESET_WAIT, RESET_TIMEOUT);
+      break;
+
+    case RADIO_RESET_WAIT:
+      if (bus.misoLow())
+      {
+        bus.deselect();
+        if (initializeRegisters()) // init CC1101 registers
+        {
+#if RX_FSCAL_CACHE
+          if (fscalValid)
+          {
+            // still calibrated for this frequency, written back before RX
+            enterState(RADIO_IDLE_WAIT, IDLE_TIMEOUT);
+            break;
+          }
+#endif
+          cmdStrobe(CC1101_SCAL);
+          enterState(RADIO_CALIBRATE, CAL_TIMEOUT);
+        }
+        else
+        {
+          stateFailed("config");
+        }
+      }
+      else if (stateExpired())
+      {
+        bus.deselect();
+        stateFailed("reset");
+      }
+      break;
+
+    case RADIO_SLEEP:
+      break;
+
+    case RADIO_WAKE_WAIT:
+      if (bus.misoLow())
+      {
+        bus.deselect();
+        sleepTime += millis() - sleepStart;
+        // TEST2..TEST0 are lost in SLEEP, SRX recalibrates or the cached
+        // calibration is written back
+        run(Cc1101Batch().writeBurst(CC1101_TEST2, &shadow[CC1101_TEST2], 3), false);
+        enterState(RADIO_IDLE_WAIT, IDLE_TIMEOUT);
+      }
+      else if (stateExpired())
+      {
+        bus.deselect();
+        stateFailed("wake up");
+      }
+      break;
+
+    case RADIO_CALIBRATE:
+    case RADIO_IDLE_WAIT:
+      marcState = readReg(CC1101_MARCSTATE, CC1101_STATUS_REGISTER);
+      if (marcState == MARCSTATE_IDLE && state == RADIO_CALIBRATE)
+      {
+        calibrationDone();
+      }
+
+      if (marcState == MARCSTATE_IDLE && calibratePending)
+      {
+        calibratePending = false;
+        cmdStrobe(CC1101_SCAL);
+        enterState(RADIO_CALIBRATE, CAL_TIMEOUT);
+      }
+      else if (marcState == MARCSTATE_IDLE)
+      {
+        // flush receive queue and enter RX state
+#if RX_FSCAL_CACHE
+        // with the cached calibration, the synthesizer only has to settle
+        run(Cc1101Batch().strobe(CC1101_SFRX)
+                         .write(CC1101_FSCAL3, fscal[0])
+                         .write(CC1101_FSCAL2, fscal[1])
+                         .write(CC1101_FSCAL1, fscal[2])
+                         .strobe(CC1101_SRX), false);
+        fscalRestores++;
+#else
+        run(Cc1101Batch().strobe(CC1101_SFRX).strobe(CC1101_SRX));
+#endif
+        enterState(RADIO_RX_WAIT, RX_TIMEOUT);
+      }
+      else if (stateExpired())
+      {
+        stateFailed(state == RADIO_CALIBRATE ? "calibrated idle" : "idle");
+      }
+      break;
+
+    case RADIO_RX_WAIT:
+      marcState = readReg(CC1101_MARCSTATE, CC1101_STATUS_REGISTER);
+      if (marcState == MARCSTATE_RX)
+      {
+        if (blindPending)
+        {
+          blindTime.add(micros() - frameEnd);
+          blindPending = false;
+        }
+        retries = 0;
+        packetAvailable = false; // anything before is stale
+        syncSeen = false;
+        if (recovering >= 0)
+        {
+          recovery[recovering].add(micros() - recoverStart);
+          recovering = -1;
+        }
+        enterState(RADIO_RX, 0);
+      }
+      else if (stateExpired())
+      {
+        stateFailed("RX");
+      }
+      break;
+
+    case RADIO_RX:
+      // Check for packets via interrupt
+#if RX_STREAMING
+      // poll while a frame is in progress, the tail may stay below the threshold
+      if (packetAvailable || rxPos)
+#else
+      if (packetAvailable)
+#endif
+      {
+#if RX_STREAMING
+        // GDO0 stays attached, the receiver stays in RX and the next frame
+        // may cross the fifo threshold while this one is drained, its edge
+        // must not be lost. Cleared before draining, a new edge means new bytes.
+        packetAvailable = false;
+        receive();
+#else
+        //  Disable wireless reception interrupt
+        bus.detachGdo0();
+
+        // clear the flag
+        packetAvailable = false;
+        receive();
+
+        // Enable wireless reception interrupt
+        bus.attachGdo0(cc1101Isr, this, CC1101_GDO0_EDGE);
+#endif
+      }
+#if RX_STREAMING
+      // frame bytes stopped arriving
+      if (rxPos && micros() - rxLastChunk > FIFO_TIMEOUT)
+      {
+        dropFrame(WAKEUP_TRUNCATED);
+      }
+#endif
+
+      // new frequency correction, the synthesizer takes it on calibration
+      if (state == RADIO_RX && freqOffsetRequest != freqOffset && !isBusy())
+      {
+        freqOffset = freqOffsetRequest;
+        freqCorrections++;
+#if DEBUG >= 1
+        Serial.printf("Frequency correction: %d (%d Hz)\n",
+                      freqOffset, (int)((int32_t)freqOffset * 26000000L / 16384));
+#endif
+        writeReg(CC1101_FSCTRL0, freqOffset);
+#if RX_FSCAL_CACHE
+        calibratePending = true; // no auto calibration on the way to RX
+#endif
+        startReceiver();
+      }
+
+      // new calibration when asked for, the temperature moved or it's too old
+      if (state == RADIO_RX && !isBusy() && (calibrateRequest || calibrationStale()))
+      {
+        if (calibrateRequest.exchange(false)) calRequested++;
+#if DEBUG >= 1
+        Serial.println("Calibrating the synthesizer");
+#endif
+        calibratePending = true;
+        startReceiver();
+      }
+
+      // Periodic status output and check every 10 seconds, or on request
+      if (state == RADIO_RX && !isBusy() && (millis() - lastStatusOutput > 10000 || checkRequest))
+      {
+        uint8_t rxBytes, rssi;
+        uint8_t values[CC1101_SPOT_CHECK_SIZE];
+        Cc1101Batch batch;
+
+        lastStatusOutput = millis();
+        checkRequest = false;
+        batch.read(CC1101_MARCSTATE, CC1101_STATUS_REGISTER, &marcState)
+             .read(CC1101_RXBYTES, CC1101_STATUS_REGISTER, &rxBytes)
+             .read(CC1101_RSSI, CC1101_STATUS_REGISTER, &rssi);
+        addSpotCheck(batch, values);
+        run(batch);
+
+        printStatus(marcState, rxBytes, rssi);
+
+        // Check if the chip still has its configuration
+        if (!configIntact(values))
+        {
+          silentResets++;
+          Serial.println("CC1101 lost its configuration");
+          applyRecovery(RECOVER_RESTORE);
+        }
+        // Check for FIFO overflow (shouldn't happen with proper GDO0 interrupt handling)
+        else if (marcState == MARCSTATE_RXFIFO_OVERFLOW || (rxBytes & 0x80))
+        {
+          Serial.println("Warning: RX FIFO overflow detected!");
+          applyRecovery(RECOVER_FLUSH);
+        }
+        // Check if we're still in RX mode
+        else if (marcState != MARCSTATE_RX)
+        {
+          Serial.printf("Not in RX mode (state: 0x%02X)\n", marcState);
+          applyRecovery(marcState == MARCSTATE_IDLE ? RECOVER_RX : RECOVER_CALIBRATE);
+        }
+      }
+      break;
+  }
+}
+
+void Cc1101Radio::printStatus(uint8_t marcState, uint8_t rxBytes, uint8_t rssi)
+{
+  Serial.printf("CC1101 Status - MARC: 0x%02X, RX bytes: %d, RSSI: %d dBm\n",
+                marcState, rxBytes & 0x7F, rssiToDbm(rssi));
+
+  Serial.printf("Frame queue - used: %d/%d, high water: %d, drops: %u\n",
+                frameQueue.size(), frameQueue.capacity(),
+                frameQueue.highWaterMark(), frameQueue.dropCount());
+
+  Serial.printf("Radio - resets: %u, state timeouts: %u, MISO timeouts: %u\n",
+                resetCount, timeoutCount, misoTimeouts);
+
+  Serial.printf("Wakeups - interrupts: %u, frames: %u, header: %u, coding: %u, block CRC: %u, "
+                "truncated: %u, CRC errors: %u, noise: %u bytes, %u us\n",
+                gdo0Interrupts, wakeups.count[WAKEUP_FRAME], wakeups.count[WAKEUP_HEADER],
+                wakeups.count[WAKEUP_CODING], wakeups.count[WAKEUP_BLOCK_CRC],
+                wakeups.count[WAKEUP_TRUNCATED],
+                wakeups.crcErrors, wakeups.noiseBytes, wakeups.noiseTime);
+
+  Serial.printf("Config - profile: %s, loads: %u, last: %u us, verify errors: %u, profile switches: %u\n",
+                profileName(profile), configTime.count, configTime.last, configErrors, profileSwitches);
+
+  Serial.printf("Shadow - skipped writes: %u, silent resets: %u, restored registers: %u\n",
+                skippedWrites, silentResets, restoredRegs);
+
+  Serial.printf("Frequency - correction: %d, changes: %u\n", freqOffset, freqCorrections);
+
+  Serial.printf("Calibration - count: %u, requested: %u, temperature: %u, expired: %u",
+                calibrations, calRequested, calTemperatureChanges, calExpired);
+#if RX_FSCAL_CACHE
+  Serial.printf(", cached restores: %u", fscalRestores);
+#endif
+  Serial.println();
+
+  if (sleepCount)
+  {
+    Serial.printf("Sleep - count: %u, total: %u s\n", sleepCount, sleepTime / 1000);
+  }
+
+  Serial.printf("Recovery -");
+  for (uint8_t i = 0; i < RECOVER_STAGES; i++)
+  {
+    const RecoveryStats &r = recovery[i];
+    Serial.printf(" %s: %u (%u escalated, max %u us)%s", stageName((RecoveryStage)i),
+                  r.count, r.escalated, r.time.max, i < RECOVER_STAGES - 1 ? "," : "\n");
+  }
+
+  if (frameCount)
+  {
+    Serial.printf("SPI per frame - transactions: %u, bytes: %u, time: %u us\n",
+                  spiStats.transactions / frameCount, spiStats.bytes / frameCount,
+                  spiStats.time / frameCount);
+  }
+
+  Serial.printf("SPI time - strobe: %u us (%u), read: %u us (%u), write: %u us (%u), burst read: %u us (%u)\n",
+                spiStats.opTime[SPI_STROBE], spiStats.count[SPI_STROBE],
+                spiStats.opTime[SPI_READ], spiStats.count[SPI_READ],
+                spiStats.opTime[SPI_WRITE], spiStats.count[SPI_WRITE],
+                spiStats.opTime[SPI_READ_BURST], spiStats.count[SPI_READ_BURST]);
+
+  if (drainTime.count)
+  {
+    Serial.printf("FIFO drain - frames: %u, last: %u us, max: %u us, avg: %u us\n",
+                  drainTime.count, drainTime.last, drainTime.max, drainTime.avg());
+  }
+
+  if (blindTime.count)
+  {
+    Serial.printf("RX blind time - frames: %u, last: %u us, max: %u us, avg: %u us\n",
+                  blindTime.count, blindTime.last, blindTime.max, blindTime.avg());
+  }
+}
+
+int Cc1101Radio::recoveryToJson(char *buf, size_t len) const
+{
+  static_assert(RECOVER_BUCKETS == 8, "histogram format");
+  int n = snprintf(buf, len, "{");
+
+  for (uint8_t i = 0; i < RECOVER_STAGES; i++)
+  {
+    const RecoveryStats &r = recovery[i];
+    const uint16_t *h = r.histogram;
+
+    n += snprintf(buf + n, n < (int)len ? len - n : 0,
+                  "%s\"%s\":{\"count\":%u,\"escalated\":%u,\"avg_us\":%u,\"max_us\":%u,"
+                  "\"hist\":[%u,%u,%u,%u,%u,%u,%u,%u]}",
+                  i ? "," : "", stageName((RecoveryStage)i), r.count, r.escalated,
+                  r.time.avg(), r.time.max, h[0], h[1], h[2], h[3], h[4], h[5], h[6], h[7]);
+  }
+
+  n += snprintf(buf + n, n < (int)len ? len - n : 0, "}");
+  return n;
+}
+
+int Cc1101Radio::wakeupsToJson(char *buf, size_t len) const
+{
+  int n = snprintf(buf, len, "{\"interrupts\":%u", gdo0Interrupts);
+
+  for (uint8_t i = 0; i < WAKEUP_CLASSES; i++)
+  {
+    n += snprintf(buf + n, n < (int)len ? len - n : 0, ",\"%s\":%u",
+                  wakeupName((WakeupClass)i), wakeups.count[i]);
+  }
+
+  n += snprintf(buf + n, n < (int)len ? len - n : 0,
+                ",\"crc_errors\":%u,\"noise_bytes\":%u,\"noise_us\":%u}",
+                wakeups.crcErrors, wakeups.noiseBytes, wakeups.noiseTime);
+  return n;
+}
+
+// program the RF profile with a single burst write, IOCFG2 .. TEST0
+// returns false, if the readback doesn't match
+bool Cc1101Radio::initializeRegisters(void)
+{
+  const uint8_t *regs;
+  uint32_t start = micros();
+
+  profile = profileRequest;
+  regs = profiles[profile].regs;
+
+  writeBurstReg(CC1101_IOCFG2, regs, CC1101_CONFIG_SIZE);
+
+#if RADIO_VERIFY_CONFIG
+  uint8_t readback[CC1101_CONFIG_SIZE];
+  readBurstReg(readback, CC1101_IOCFG2, CC1101_CONFIG_SIZE);
+
+  for (uint8_t i = 0; i < CC1101_CONFIG_SIZE; i++)
+  {
+    if (readback[i] != regs[i])
+    {
+      configErrors++;
+      Serial.printf("Register 0x%02X verify failed: 0x%02X, expected 0x%02X\n",
+                    i, readback[i], regs[i]);
+      return false;
+    }
+  }
+#endif
+
+  shadowValid = true; // shadow was filled by the burst write
+  writeReg(CC1101_FSCTRL0, freqOffset); // keep the frequency correction
+  configTime.add(micros() - start);
+  return true;
+}
+
+// number of bytes in the RX fifo, bit 7 is the overflow flag
+// read twice until stable (CC1101 errata: SPI read synchronization),
+// both reads and optionally the link status in one transaction
+uint8_t Cc1101Radio::readRxBytes(bool link)
+{
+  uint8_t rxBytes, last;
+
+  do
+  {
+    Cc1101Batch batch;
+    if (link) addLinkStatus(batch);
+    batch.read(CC1101_RXBYTES, CC1101_STATUS_REGISTER, &last)
+         .read(CC1101_RXBYTES, CC1101_STATUS_REGISTER, &rxBytes);
+    if (!run(batch)) break;
+  } while (rxBytes != last);
+
+  return rxBytes;
+}
+
+// drain len bytes from the RX fifo using burst reads, as they arrive
+// returns false if the bytes got lost by a fifo overflow or do not show up in time
+bool Cc1101Radio::readFifo(uint8_t *buffer, uint16_t len)
+{
+  uint32_t start = micros();
+
+  while (len > 0)
+  {
+    uint8_t rxBytes = readRxBytes();
+    uint8_t avail = rxBytes & 0x7F;
+
+    if (avail >= len)
+    {
+      avail = len;
+    }
+    else if (rxBytes & 0x80)
+    {
+      return false; // overflow, the rest of the frame is lost
+    }
+    else if (avail > 0)
+    {
+      // frame is still arriving, never empty the fifo completely
+      // while receiving (CC1101 errata)
+      avail--;
+    }
+
+    if (avail == 0)
+    {
+      if (micros() - start > FIFO_TIMEOUT)
+      {
+        return false;
+      }
+      continue;
+    }
+
+    readBurstReg(buffer, CC1101_RXFIFO, avail);
+    buffer += avail;
+    len -= avail;
+  }
+
+  return true;
+}
+
+#if RX_STREAMING
+// streaming receive, called on each RX FIFO threshold interrupt
+// drains what is in the fifo and assembles the frame in rxFrame
+// returns true, if the frame is complete
+bool Cc1101Radio::receiveChunk(void)
+{
+  uint32_t chunkStart = micros();
+  uint8_t rxBytes = readRxBytes(rxPos == 0);
+  uint8_t avail = rxBytes & 0x7F;
+
+  if (rxPos == 0 && avail == 0 && !(rxBytes & 0x80))
+  {
+    return false; // edge of bytes drained already, the next frame isn't in yet
+  }
+
+  if (rxPos == 0)
+  {
+    setLinkStatus(rxFrame); // link status at start of frame
+    rxFrame->syncTime = frameSyncTime(avail);
+    rxDecoder.begin(rxFrame->data, sizeof(rxFrame->data));
+  }
+
+  while (avail > 0)
+  {
+    // header (preamble + L-field) first, then the rest of the frame
+    uint16_t want = (rxLen ? rxLen + rxStatusLen : headerLength()) - rxPos;
+    uint8_t n;
+
+    if (avail >= want)
+      n = want;
+    else if (rxBytes & 0x80)
+      break; // overflow, the rest of the frame is lost
+    else
+      n = avail - 1; // still arriving, never empty the fifo (CC1101 errata)
+
+    if (n == 0) break;
+
+    readBurstReg(&rxFrame->data[rxPos], CC1101_RXFIFO, n);
+
+    // mode T1: decode the chunk in place, without the appended status bytes
+    if (profiles[profile].coded && (rxLen == 0 || rxPos < rxLen))
+    {
+      uint16_t coded = (rxLen && rxPos + n > rxLen) ? rxLen - rxPos : n;
+      if (!rxDecoder.feed(&rxFrame->data[rxPos], coded))
+      {
+        rxDrainTime += micros() - chunkStart;
+        dropFrame(WAKEUP_CODING);
+        return false;
+      }
+    }
+
+    rxPos += n;
+    avail -= n;
+    rxLastChunk = micros();
+
+    if (rxLen == 0 && rxPos == headerLength())
+    {
+      rxLen = frameLength(); // now we know the frame length
+      if (rxLen == 0)
+      {
+        // noise that happened to contain the sync word, don't drain it
+        rxDrainTime += micros() - chunkStart;
+        dropFrame(WAKEUP_HEADER);
+        return false;
+      }
+
+      // mode T frames are format A, mode C tells by the preamble
+      rxFormatA = profiles[profile].coded || rxFrame->data[1] == 0xCD;
+      if (rxFormatA)
+      {
+        rxBlocks.begin(profiles[profile].coded ? rxFrame->data : &rxFrame->data[2]);
+      }
+      else
+      {
+        // from the L-field on, a long frame has a second block
+        rxCrcFed = 2;
+        rxCrcEnd = rxFrame->data[2] > WMBUS_B_BLOCK + 1 ? 2 + WMBUS_B_BLOCK : rxLen - 2;
+      }
+
+#if RX_CONTINUOUS
+      // let the CC1101 end the frame by itself, if it's not too late
+      // (packet length counter must not have passed PKTLEN yet)
+      Cc1101Batch batch;
+      if (rxLen <= 0xFF && rxLen > rxPos + avail + 2)
+      {
+        batch.write(CC1101_PKTLEN, rxLen)
+             .write(CC1101_PKTCTRL0, CC1101_PKTCTRL0_FIXED);
+        rxFixedLength = true;
+        rxStatusLen = 2; // APPEND_STATUS
+      }
+      run(batch.write(CC1101_FIFOTHR, CC1101_FIFOTHR_FRAME));
+#endif
+    }
+
+    // format A: each block's CRC as soon as the block is in, the CRCs
+    // are removed in place, a corrupt frame isn't drained any further
+    if (rxFormatA)
+    {
+      uint16_t have = profiles[profile].coded ? rxDecoder.size() : (rxPos < rxLen ? rxPos : rxLen) - 2;
+      if (!rxBlocks.feed(have - rxBlocksFed))
+      {
+        rxDrainTime += micros() - chunkStart;
+        dropFrame(WAKEUP_BLOCK_CRC);
+        return false;
+      }
+      rxBlocksFed = have;
+    }
+    // format B: the CRC runs along with each chunk, the verdict is there
+    // with the last byte, without a second pass over the frame
+    else if (rxLen)
+    {
+      while (true)
+      {
+        uint16_t end = rxPos < rxCrcEnd ? rxPos : rxCrcEnd;
+        if (end > rxCrcFed)
+        {
+          rxCrc = crcEN13575Update(rxCrc, &rxFrame->data[rxCrcFed], end - rxCrcFed);
+          rxCrcFed = end;
+        }
+
+        // first block and its CRC in, start over for the second block
+        if (rxCrcEnd == rxLen - 2 || rxPos < rxCrcEnd + 2) break;
+        rxCrcOk = (uint16_t)~rxCrc == (rxFrame->data[rxCrcEnd] << 8 | rxFrame->data[rxCrcEnd + 1]);
+        rxCrc = 0;
+        rxCrcFed = rxCrcEnd + 2;
+        rxCrcEnd = rxLen - 2;
+      }
+    }
+
+    if (rxPos == rxLen + rxStatusLen) break;
+  }
+
+  rxDrainTime += micros() - chunkStart;
+
+  if (rxLen && rxPos == rxLen + rxStatusLen)
+  {
+    if (rxStatusLen)
+    {
+      // status bytes latched by the CC1101 at the end of the frame
+      rxFrame->rssi = rssiToDbm(rxFrame->data[rxLen]);
+      rxFrame->lqi = rxFrame->data[rxLen + 1] & 0x7F;
+    }
+    drainTime.add(rxDrainTime);
+    return true;
+  }
+
+  if (rxBytes & 0x80)
+  {
+    dropFrame(WAKEUP_TRUNCATED); // overflow
+  }
+
+  return false;
+}
+
+// mode C: preamble 0x54 0xCD/0x3D + L-field, mode T: the coded L-field
+uint8_t Cc1101Radio::headerLength(void)
+{
+  return profiles[profile].coded ? 2 : 3;
+}
+
+// bytes on air, mode T: coded format A frame, the L-field is decoded already
+// 0, if the header can't be WMBus
+uint16_t Cc1101Radio::frameLength(void)
+{
+  if (!profiles[profile].coded)
+  {
+    if (!plausibleHeader(rxFrame->data)) return 0;
+    return rxFrame->data[1] == 0xCD ? 2 + formatALength(rxFrame->data[2]) : 3 + rxFrame->data[2];
+  }
+  if (rxFrame->data[0] < WMBUS_MIN_LENGTH)
+  {
+    return 0;
+  }
+  return length3of6(formatALength(rxFrame->data[0]));
+}
+#else
+// GDO0 deasserted: in infinite length mode the fifo overflows after
+// the first 64 bytes of the frame, drain them
+// returns true, if the frame is complete
+bool Cc1101Radio::receiveFrame(void)
+{
+  uint32_t drainStart = micros();
+
+  // GDO0 deasserts on fifo overflow, the fifo is full
+  rxFrame->syncTime = frameSyncTime(CC1101_FIFO_SIZE);
+
+  // preamble + L-field
+  if (!readFifo(rxFrame->data, 3))
+  {
+#if DEBUG >= 1
+    Serial.println("RX fifo overflow/timeout while reading header");
+#endif
+    dropFrame(WAKEUP_TRUNCATED);
+    return false;
+  }
+
+  // format A needs RX_STREAMING, its CRCs are checked while draining
+  uint8_t len = rxFrame->data[2];
+  if (!plausibleHeader(rxFrame->data) || rxFrame->data[1] != 0x3D || len + 3 > CC1101_FIFO_SIZE)
+  {
+#if DEBUG >= 1
+    Serial.printf("Invalid header: %02X%02X, length: %d (max: %d)\n",
+                  rxFrame->data[0], rxFrame->data[1], len, CC1101_FIFO_SIZE - 3);
+#endif
+    dropFrame(WAKEUP_HEADER);
+    return false;
+  }
+
+  // Read the rest of the data
+  if (!readFifo(&rxFrame->data[3], len))
+  {
+#if DEBUG >= 1
+    Serial.println("RX fifo overflow/timeout, frame dropped");
+#endif
+    dropFrame(WAKEUP_TRUNCATED);
+    return false;
+  }
+
+  drainTime.add(micros() - drainStart);
+  return true;
+}
+#endif
+
+// reads a frame from the CC1101 into the frame queue
+// and restarts the CC1101 receiver
+void Cc1101Radio::receive()
+{
+  if (rxFrame == nullptr)
+  {
+    // start of a new frame
+    rxFrame = frameQueue.reserve();
+    if (rxFrame == nullptr)
+    {
+#if DEBUG >= 1
+      Serial.println("Frame queue full, frame dropped");
+#endif
+      startReceiver();
+      return;
+    }
+    rxFrame->timestamp = millis();
+    rxFrame->profile = profile;
+#if !RX_STREAMING
+    Cc1101Batch batch;
+    addLinkStatus(batch);
+    run(batch);
+    setLinkStatus(rxFrame);
+#endif
+  }
+
+#if RX_STREAMING
+  if (!receiveChunk())
+  {
+    return; // frame not complete yet, wait for next threshold interrupt
+  }
+#else
+  if (!receiveFrame())
+  {
+    return; // dropped, receiver restarted
+  }
+#endif
+
+  // hand it over to the decode stage
+#if RX_STREAMING
+  // format A without its block CRCs, after the preamble for mode C
+  rxFrame->formatA = rxFormatA;
+  rxFrame->length = rxFormatA ? (profiles[profile].coded ? 0 : 2) + rxBlocks.size() : rxLen;
+  rxFrame->crcOk = rxFormatA || (rxCrcOk &&
+                   (uint16_t)~rxCrc == (rxFrame->data[rxLen - 2] << 8 | rxFrame->data[rxLen - 1]));
+  // long format B: the CRC after the first block goes, like the block
+  // CRCs of format A, so the data is contiguous for decryption
+  if (!rxFormatA && rxFrame->data[2] > WMBUS_B_BLOCK + 1)
+  {
+    uint8_t *crc = &rxFrame->data[2 + WMBUS_B_BLOCK];
+    memmove(crc, crc + 2, rxLen - (2 + WMBUS_B_BLOCK + 2));
+    rxFrame->length -= 2;
+  }
+#else
+  rxFrame->formatA = false; // format B only, frames up to 61 bytes
+  rxFrame->length = 3 + rxFrame->data[2];
+  rxFrame->crcOk = crcEN13575(&rxFrame->data[2], rxFrame->length - 4) ==
+                   (rxFrame->data[rxFrame->length - 2] << 8 | rxFrame->data[rxFrame->length - 1]);
+#endif
+  frameQueue.commit();
+  frameCount++;
+  wakeups.count[WAKEUP_FRAME]++;
+  lastStage = -1; // receiving again, whatever the last recovery was
+  rxFrame = nullptr;
+  frameEnd = micros();
+
+#if RX_CONTINUOUS
+  if (rxFixedLength)
+  {
+    // CC1101 is back in RX already
+    rearmReceiver();
+    abortFrame();
+    blindTime.add(micros() - frameEnd);
+    return;
+  }
+#endif
+
+  // flush RX fifo and restart receiver
+  startReceiver();
+  blindPending = true;
+}
+
+#if RX_CONTINUOUS
+// back to infinite length and the frame start threshold for the next
+// frame, the CC1101 may stay in RX
+void Cc1101Radio::rearmReceiver(void)
+{
+  if (rxLen == 0)
+  {
+    return; // L-field not seen, nothing changed
+  }
+
+  Cc1101Batch batch;
+  if (rxFixedLength)
+  {
+    batch.write(CC1101_PKTCTRL0, CC1101_DEFVAL_PKTCTRL0);
+  }
+  run(batch.write(CC1101_FIFOTHR, CC1101_DEFVAL_FIFOTHR));
+}
+#endif
+
+IRAM_ATTR void Cc1101Radio::instanceCC1101Isr()
+{
+  // set the flag that a package is available
+  packetAvailable = true;
+  gdo0Interrupts++;
+
+#if defined(ESP32)
+  // wake up the radio task
+  BaseType_t woken = pdFALSE;
+  vTaskNotifyGiveFromISR(radioTaskHandle, &woken);
+  if (woken) portYIELD_FROM_ISR();
+#endif
+}
+
+void Cc1101Radio::addLinkStatus(Cc1101Batch &batch)
+{
+  batch.read(CC1101_RSSI, CC1101_STATUS_REGISTER, &linkRegs[0])
+       .read(CC1101_LQI, CC1101_STATUS_REGISTER, &linkRegs[1])
+       .read(CC1101_FREQEST, CC1101_STATUS_REGISTER, &linkRegs[2]);
+}
+
+void Cc1101Radio::setLinkStatus(RawFrame *frame)
+{
+  frame->rssi = rssiToDbm(linkRegs[0]);
+  frame->lqi = linkRegs[1] & 0x7F; // bit 7: CRC_OK, not used for WMBus
+  frame->freqEst = (int8_t)linkRegs[2];
+  frame->freqOffset = freqOffset;
+}
+
+uint32_t Cc1101Radio::frameSyncTime(uint8_t received)
+{
+  uint32_t now = micros();
+  uint32_t onAir = (uint32_t)received * CC1101_BYTE_TIME; // since the sync word
+
+  // GDO2 sync word time, unless it's from long before this frame
+  // (noise on the pin, or a sync word without a frame)
+  if (syncSeen)
+  {
+    syncSeen = false;
+    if (now - syncTime <= onAir + CC1101_SYNC_SLACK)
+    {
+      return syncTime;
+    }
+  }
+
+  return now - onAir;
+}
+
+// GDO2 rising edge: sync word received
+IRAM_ATTR void Cc1101Radio::syncIsr(void *p)
+{
+  Cc1101Radio *ptr = (Cc1101Radio *)p;
+  ptr->syncTime = micros();
+  ptr->syncSeen = true;
+}
+
+// static ISR method, that calls the right instance
+IRAM_ATTR void Cc1101Radio::cc1101Isr(void *p)
+{
+  Cc1101Radio *ptr = (Cc1101Radio *)p;
+  ptr->instanceCC1101Isr();
+}
+
+#if defined(ESP32)
+// radio task, woken up by the GDO0 interrupt
+void Cc1101Radio::radioTask(void *p)
+{
+  Cc1101Radio *ptr = (Cc1101Radio *)p;
+
+  for (;;)
+  {
+    // wait for the ISR, tick every 1 ms while waiting for the chip,
+    // otherwise every 10 ms for the housekeeping
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(ptr->isBusy() ? 1 : 10));
+    ptr->tick();
+  }
+}
+#endif
+
+// Initialize CC1101 to receive WMBus MODE C1
+void Cc1101Radio::begin(void)
+{
+  bus.begin();
+  enterState(RADIO_RESET, 0);
+
+#if defined(ESP32)
+  // above loopTask priority, so a blocking WiFi/MQTT reconnect
+  // doesn't stop the capture
+  xTaskCreate(radioTask, "cc1101", 4096, this, 2, &radioTaskHandle);
+#endif
+
+  bus.attachGdo0(cc1101Isr, this, CC1101_GDO0_EDGE);
+  gdo2Attached = bus.attachGdo2(syncIsr, this, RISING);
+}
@@ -0,0 +1,122 @@
+#include "Cc1101SpiBus.h"
+
+Cc1101SpiBus *volatile Cc1101SpiBus::owner = nullptr;
+#if defined(ESP32)
+SemaphoreHandle_t Cc1101SpiBus::lock = nullptr;
+#endif
+
+Cc1101SpiBus::Cc1101SpiBus(uint8_t cs, uint8_t miso, uint8_t mosi, uint8_t sck, uint8_t gdo0,
+                           uint8_t gdo2)
+  : csPin   (cs)
+  , misoPin (miso)
+  , mosiPin (mosi)
+  , sckPin  (sck)
+  , gdo0Pin (gdo0)
+  , gdo2Pin (gdo2)
+{
+}
+
+void Cc1101SpiBus::begin(void)
+{
+  if (started)
+  {
+    return; // done before the first chip on the bus was reset
+  }
+  started = true;
+
+#if defined(ESP32)
+  if (lock == nullptr)
+  {
+    lock = xSemaphoreCreateMutex();
+  }
+#endif
+
+  pinMode(csPin, OUTPUT);      // CS Pin -> Output
+  digitalWrite(csPin, HIGH);
+  SPI.begin();                 // Initialize SPI interface
+  pinMode(gdo0Pin, INPUT);     // Config GDO0 as input
+
+  Serial.printf("GDO0 interrupt pin configured on GPIO%d\n", gdo0Pin);
+
+  if (gdo2Pin != CC1101_NO_PIN)
+  {
+    pinMode(gdo2Pin, INPUT);   // Config GDO2 as input
+    Serial.printf("GDO2 sync word interrupt pin configured on GPIO%d\n", gdo2Pin);
+  }
+}
+
+// ChipSelect assert, waits until no other chip on the bus is selected
+void Cc1101SpiBus::select(void)
+{
+  if (owner != this)
+  {
+#if defined(ESP32)
+    xSemaphoreTake(lock, portMAX_DELAY);
+#endif
+    owner = this;
+  }
+  digitalWrite(csPin, LOW);
+}
+
+// ChipSelect deassert
+void Cc1101SpiBus::deselect(void)
+{
+  digitalWrite(csPin, HIGH);
+  if (owner == this)
+  {
+    owner = nullptr;
+#if defined(ESP32)
+    xSemaphoreGive(lock);
+#endif
+  }
+}
+
+bool Cc1101SpiBus::available(void)
+{
+  return owner == nullptr || owner == this;
+}
+
+bool Cc1101SpiBus::misoLow(void)
+{
+  return digitalRead(misoPin) == LOW;
+}
+
+uint8_t Cc1101SpiBus::transfer(uint8_t value)
+{
+  return SPI.transfer(value);
+}
+
+void Cc1101SpiBus::resetPins(void)
+{
+  digitalWrite(mosiPin, LOW);
+  digitalWrite(sckPin, HIGH); // see CC1101 datasheet 11.3
+}
+
+void Cc1101SpiBus::attachGdo0(void (*isr)(void *), void *arg, int mode)
+{
+  attachInterruptArg(digitalPinToInterrupt(gdo0Pin), isr, arg, mode);
+}
+
+void Cc1101SpiBus::detachGdo0(void)
+{
+  detachInterrupt(digitalPinToInterrupt(gdo0Pin));
+}
+
+bool Cc1101SpiBus::attachGdo2(void (*isr)(void *), void *arg, int mode)
+{
+  if (gdo2Pin == CC1101_NO_PIN)
+  {
+    return false;
+  }
+
+  attachInterruptArg(digitalPinToInterrupt(gdo2Pin), isr, arg, mode);
+  return true;
+}
+
+void Cc1101SpiBus::detachGdo2(void)
+{
+  if (gdo2Pin != CC1101_NO_PIN)
+  {
+    detachInterrupt(digitalPinToInterrupt(gdo2Pin));
+  }
+}
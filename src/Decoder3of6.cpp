@@ -0,0 +1,80 @@
+#include "Decoder3of6.h"
+
+// nibble of each 6 bit code, 0xFF: not a valid code
+static const uint8_t nibbles[64] =
+{
+  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, // 0x00
+  0xFF, 0xFF, 0xFF, 0x03, 0xFF, 0x01, 0x02, 0xFF, // 0x08
+  0xFF, 0xFF, 0xFF, 0x07, 0xFF, 0xFF, 0x00, 0xFF, // 0x10
+  0xFF, 0x05, 0x06, 0xFF, 0x04, 0xFF, 0xFF, 0xFF, // 0x18
+  0xFF, 0xFF, 0xFF, 0x0B, 0xFF, 0x09, 0x0A, 0xFF, // 0x20
+  0xFF, 0x0F, 0xFF, 0xFF, 0x08, 0xFF, 0xFF, 0xFF, // 0x28
+  0xFF, 0x0D, 0x0E, 0xFF, 0x0C, 0xFF, 0xFF, 0xFF, // 0x30
+  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF  // 0x38
+};
+
+void Decoder3of6::begin(uint8_t *buffer, uint16_t size)
+{
+  out = buffer;
+  capacity = size;
+  pos = 0;
+  bits = 0;
+  bitCount = 0;
+  errors = 0;
+}
+
+void Decoder3of6::put(uint8_t high, uint8_t low)
+{
+  if ((high | low) & 0x80)
+  {
+    errors++;
+    high &= 0x0F;
+    low &= 0x0F;
+  }
+
+  if (pos < capacity)
+  {
+    out[pos++] = high << 4 | low;
+  }
+}
+
+bool Decoder3of6::feed(const uint8_t *in, uint16_t len)
+{
+  uint16_t before = errors;
+
+  while (len > 0)
+  {
+    // byte aligned: 3 coded bytes give 2 bytes, read before written
+    while (bitCount == 0 && len >= 3)
+    {
+      uint8_t a = in[0], b = in[1], c = in[2];
+      in += 3;
+      len -= 3;
+      put(nibbles[a >> 2], nibbles[(a & 0x03) << 4 | b >> 4]);
+      put(nibbles[(b & 0x0F) << 2 | c >> 6], nibbles[c & 0x3F]);
+    }
+
+    if (len == 0) break;
+
+    bits = bits << 8 | *in++;
+    bitCount += 8;
+    len--;
+
+    if (bitCount >= 12)
+    {
+      bitCount -= 12;
+      put(nibbles[(bits >> (bitCount + 6)) & 0x3F], nibbles[(bits >> bitCount) & 0x3F]);
+    }
+  }
+
+  return errors == before;
+}
+
+bool decode3of6(const uint8_t *in, uint8_t *out, uint16_t len)
+{
+  Decoder3of6 decoder;
+
+  decoder.begin(out, len);
+  decoder.feed(in, (len * 3 + 1) / 2);
+  return decoder.errorCount() == 0 && decoder.size() == len;
+}
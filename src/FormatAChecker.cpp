@@ -0,0 +1,65 @@
+#include "FormatAChecker.h"
+
+void FormatAChecker::begin(uint8_t *buffer)
+{
+  buf = buffer;
+  in = 0;
+  out = 0;
+  total = 0;
+  blockLeft = 10; // L-field .. A-field
+  crcSeen = 0;
+  crc = 0;
+  calc = 0;
+  blocks = 0;
+  done = false;
+}
+
+void FormatAChecker::nextBlock(void)
+{
+  uint16_t left = total - out;
+
+  blockLeft = left > 16 ? 16 : left;
+  crcSeen = 0;
+  crc = 0;
+  calc = 0;
+}
+
+bool FormatAChecker::feed(uint16_t len)
+{
+  uint16_t end = in + len;
+
+  while (in < end && !done)
+  {
+    if (blockLeft)
+    {
+      // data bytes move down over the CRCs before them
+      uint16_t n = end - in < blockLeft ? end - in : blockLeft;
+      if (out != in) memmove(&buf[out], &buf[in], n);
+      if (out == 0)
+      {
+        total = 1 + buf[0]; // L-field
+        if (total < blockLeft) blockLeft = total;
+        if (n > blockLeft) n = blockLeft;
+      }
+      calc = crcEN13575Update(calc, &buf[out], n);
+      in += n;
+      out += n;
+      blockLeft -= n;
+      continue;
+    }
+
+    crc = crc << 8 | buf[in++];
+    if (++crcSeen < 2) continue;
+
+    if ((uint16_t)~calc != crc)
+    {
+      return false;
+    }
+    blocks++;
+    done = out == total;
+    nextBlock();
+  }
+
+  in = end; // anything after the frame is ignored
+  return true;
+}
@@ -0,0 +1,225 @@
+#include "FrameMerger.h"
+
+bool FrameMerger::add(Queue &queue)
+{
+  if (count >= MERGE_RADIOS)
+  {
+    return false;
+  }
+
+  queues[count++] = &queue;
+  return true;
+}
+
+// meter ID and access number of a frame with a valid CRC
+bool FrameMerger::keyOf(RawFrame *frame, Key &key)
+{
+  uint8_t *p = frame->profile == PROFILE_T1 ? frame->data : &frame->data[2]; // L-field
+  uint8_t ci = 10; // index of the CI-field
+  uint8_t avail;   // checked bytes from the CI-field on
+  // index of the last byte, the radio removed the block CRCs of format A
+  // and the one after the first block of a long format B frame
+  uint16_t last = frame->length - (p - frame->data) - 1;
+
+  if (frame->formatA)
+  {
+    // block CRCs checked and removed by the radio already
+    if (p[0] < 10 || last < p[0])
+    {
+      return false;
+    }
+    avail = p[0] - 9;
+  }
+  else
+  {
+    // CRC checked by the radio while draining
+    if (p[0] < 12 || last < 12 || !frame->crcOk)
+    {
+      return false;
+    }
+    avail = last - 11;
+  }
+
+  uint8_t offset;
+  switch (p[ci])
+  {
+    case 0x7A: offset = 1; break; // short header
+    case 0x72: offset = 9; break; // long header
+    case 0x8C:                    // extended link layer: CC, ACC
+    case 0x8D: offset = 2; break;
+    default:   offset = 0; break; // unknown, the ID and sync time have to do
+  }
+
+  key.id = p[4] | p[5] << 8 | p[6] << 16 | (uint32_t)p[7] << 24;
+  key.access = offset && offset < avail ? p[ci + offset] : 0x100;
+  key.syncTime = frame->syncTime;
+  return true;
+}
+
+bool FrameMerger::sameTelegram(const Key &a, const Key &b)
+{
+  return a.id == b.id && a.access == b.access &&
+         (uint32_t)abs((int32_t)(a.syncTime - b.syncTime)) < MERGE_WINDOW;
+}
+
+// key of the frame at the head of queue 'i', the CRC is checked only once
+bool FrameMerger::headKey(uint8_t i, Key &key)
+{
+  RawFrame *frame = queues[i]->front();
+
+  if (frame != keyFrame[i])
+  {
+    keyFrame[i] = frame;
+    keyValid[i] = frame && keyOf(frame, keys[i]);
+  }
+
+  key = keys[i];
+  return keyValid[i];
+}
+
+// queue whose head frame has the oldest sync word, -1 if all are empty
+int8_t FrameMerger::oldest(void)
+{
+  int8_t best = -1;
+
+  for (uint8_t i = 0; i < count; i++)
+  {
+    RawFrame *frame = queues[i]->front();
+    if (frame && (best < 0 || (int32_t)(frame->syncTime - queues[best]->front()->syncTime) < 0))
+    {
+      best = i;
+    }
+  }
+
+  return best;
+}
+
+void FrameMerger::release(uint8_t i)
+{
+  queues[i]->pop();
+  keyFrame[i] = nullptr;
+  stats[i].frames++;
+}
+
+RawFrame *FrameMerger::front(uint32_t now)
+{
+  if (selected >= 0)
+  {
+    return queues[selected]->front();
+  }
+
+  for (;;)
+  {
+    int8_t i = oldest();
+    Key key;
+
+    if (i < 0)
+    {
+      return nullptr;
+    }
+
+    RawFrame *frame = queues[i]->front();
+    frame->radio = i;
+
+    if (!headKey(i, key))
+    {
+      selected = i; // CRC error, left to the decode stage
+      return frame;
+    }
+
+    // copy of a telegram passed on already
+    bool late = false;
+    for (const Key &r : recent)
+    {
+      late |= sameTelegram(r, key);
+    }
+    if (late)
+    {
+      stats[i].duplicates++;
+      release(i);
+      continue;
+    }
+
+    if (!waiting || !sameTelegram(waitKey, key))
+    {
+      waiting = true;
+      waitKey = key;
+      waitStart = now;
+      copies = false;
+    }
+
+    // copies at the head of the other queues, the stronger one stays
+    bool pending = false;
+    for (uint8_t j = 0; j < count; j++)
+    {
+      Key other;
+
+      if (j == i) continue;
+      if (queues[j]->front() == nullptr)
+      {
+        pending = true; // may still be receiving it
+        continue;
+      }
+      if (!headKey(j, other) || !sameTelegram(key, other)) continue;
+
+      copies = true;
+      if (queues[j]->front()->rssi > frame->rssi)
+      {
+        stats[i].duplicates++;
+        release(i);
+        i = j;
+        key = other;
+        frame = queues[i]->front();
+        frame->radio = i;
+      }
+      else
+      {
+        stats[j].duplicates++;
+        release(j);
+        pending |= queues[j]->front() == nullptr;
+      }
+    }
+
+    // give the other receivers time to deliver their copy
+    if (pending && now - waitStart < MERGE_HOLD)
+    {
+      return nullptr;
+    }
+
+    waiting = false;
+    if (copies)
+      stats[i].best++;
+    else
+      stats[i].only++;
+
+    recent[recentPos] = key;
+    recentPos = (recentPos + 1) % MERGE_RECENT;
+    selected = i;
+    return frame;
+  }
+}
+
+void FrameMerger::pop(void)
+{
+  if (selected >= 0)
+  {
+    release(selected);
+    selected = -1;
+  }
+}
+
+int FrameMerger::toJson(char *buf, size_t len) const
+{
+  int n = snprintf(buf, len, "[");
+
+  for (uint8_t i = 0; i < count; i++)
+  {
+    const MergeStats &s = stats[i];
+    n += snprintf(buf + n, n < (int)len ? len - n : 0,
+                  "%s{\"frames\":%u,\"best\":%u,\"only\":%u,\"duplicates\":%u}",
+                  i ? "," : "", s.frames, s.best, s.only, s.duplicates);
+  }
+
+  n += snprintf(buf + n, n < (int)len ? len - n : 0, "]");
+  return n;
+}
@@ -0,0 +1,40 @@
+#include "FreqTracker.h"
+
+bool FreqTracker::add(int8_t freqEst, int8_t applied)
+{
+  good++;
+  sum += applied + freqEst;
+  if (++count < AFC_WINDOW)
+  {
+    return false;
+  }
+
+  // rounded average
+  int16_t avg = (sum >= 0 ? sum + AFC_WINDOW / 2 : sum - AFC_WINDOW / 2) / AFC_WINDOW;
+  sum = 0;
+  count = 0;
+
+  if (avg > AFC_LIMIT) avg = AFC_LIMIT;
+  if (avg < -AFC_LIMIT) avg = -AFC_LIMIT;
+
+  if (abs(avg - offset) < AFC_THRESHOLD)
+  {
+    return false;
+  }
+
+  prevErrorRate = errorRate();
+  good = 0;
+  bad = 0;
+  offset = avg;
+  corrections++;
+  return true;
+}
+
+int FreqTracker::toJson(char *buf, size_t len) const
+{
+  return snprintf(buf, len,
+                  "{\"offset\":%d,\"offset_hz\":%d,\"corrections\":%u,"
+                  "\"crc_errors\":%u.%u,\"crc_errors_before\":%u.%u}",
+                  offset, getOffsetHz(), corrections,
+                  errorRate() / 10, errorRate() % 10, prevRate() / 10, prevRate() % 10);
+}
@@ -0,0 +1,117 @@
+#include "LinkStats.h"
+
+void LinkStats::clear(uint32_t newId)
+{
+  id = newId;
+  frames = 0;
+  pos = 0;
+  used = 0;
+}
+
+void LinkStats::add(const LinkSample &s)
+{
+  samples[pos] = s;
+  pos = (pos + 1) % LINK_WINDOW;
+  if (used < LINK_WINDOW) used++;
+  frames++;
+}
+
+static uint8_t bucket(int16_t value, int16_t min, int16_t step)
+{
+  int16_t b = (value - min) / step;
+  if (value < min || b < 0) return 0;
+  return b >= LINK_BUCKETS ? LINK_BUCKETS - 1 : b;
+}
+
+void LinkStats::rssiHistogram(uint8_t *buckets) const
+{
+  memset(buckets, 0, LINK_BUCKETS);
+  for (uint8_t i = 0; i < used; i++)
+    buckets[bucket(samples[i].rssi, LINK_RSSI_MIN, LINK_RSSI_STEP)]++;
+}
+
+void LinkStats::lqiHistogram(uint8_t *buckets) const
+{
+  memset(buckets, 0, LINK_BUCKETS);
+  for (uint8_t i = 0; i < used; i++)
+    buckets[bucket(samples[i].lqi, 0, LINK_LQI_STEP)]++;
+}
+
+int16_t LinkStats::avgRssi(void) const
+{
+  int32_t sum = 0;
+  for (uint8_t i = 0; i < used; i++) sum += samples[i].rssi;
+  return used ? sum / used : 0;
+}
+
+uint8_t LinkStats::avgLqi(void) const
+{
+  uint32_t sum = 0;
+  for (uint8_t i = 0; i < used; i++) sum += samples[i].lqi;
+  return used ? sum / used : 0;
+}
+
+int8_t LinkStats::avgFreqEst(void) const
+{
+  int32_t sum = 0;
+  for (uint8_t i = 0; i < used; i++) sum += samples[i].freqEst;
+  return used ? sum / used : 0;
+}
+
+static int histogramJson(char *buf, size_t len, const char *name, const uint8_t *buckets)
+{
+  int n = snprintf(buf, len, ",\"%s\":[", name);
+  for (uint8_t i = 0; i < LINK_BUCKETS; i++)
+  {
+    n += snprintf(buf + n, n < (int)len ? len - n : 0, i ? ",%d" : "%d", buckets[i]);
+  }
+  n += snprintf(buf + n, n < (int)len ? len - n : 0, "]");
+  return n;
+}
+
+int LinkStats::toJson(char *buf, size_t len) const
+{
+  uint8_t buckets[LINK_BUCKETS];
+  int n;
+
+  n = snprintf(buf, len, "{\"id\":\"%08x\",\"frames\":%u,\"rssi\":%d,\"lqi\":%d,\"freq_est\":%d",
+               id, frames, avgRssi(), avgLqi(), avgFreqEst());
+
+  rssiHistogram(buckets);
+  n += histogramJson(buf + n, n < (int)len ? len - n : 0, "rssi_hist", buckets);
+  lqiHistogram(buckets);
+  n += histogramJson(buf + n, n < (int)len ? len - n : 0, "lqi_hist", buckets);
+
+  n += snprintf(buf + n, n < (int)len ? len - n : 0, "}");
+  return n;
+}
+
+LinkStats &LinkTable::update(uint32_t id, const LinkSample &s, uint32_t now)
+{
+  LinkStats *entry = &meters[0];
+
+  for (uint8_t i = 0; i < LINK_METERS; i++)
+  {
+    if (meters[i].id == id)
+    {
+      entry = &meters[i];
+      break;
+    }
+
+    // otherwise a free entry, or the one not heard for the longest time
+    if (entry->id != 0 &&
+        (meters[i].id == 0 || now - meters[i].lastSeen > now - entry->lastSeen))
+    {
+      entry = &meters[i];
+    }
+  }
+
+  if (entry->id != id)
+  {
+    entry->clear(id);
+  }
+
+  entry->add(s);
+  entry->lastSeen = now;
+  return *entry;
+}
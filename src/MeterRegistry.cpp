@@ -0,0 +1,122 @@
+#include "MeterRegistry.h"
+
+int MeterState::toJson(char *buf, size_t len) const
+{
+  return snprintf(buf, len,
+                  "{\"total\":%u.%03u,\"target\":%u.%03u,\"flowtemp\":%u,\"ambienttemp\":%u,"
+                  "\"infocode\":%u,\"frames\":%u}",
+                  totalWater / 1000, totalWater % 1000, targetWater / 1000, targetWater % 1000,
+                  flowTemp, ambientTemp, infoCodes, frames);
+}
+
+// multiplicative hash, the serial numbers are decimal digits in BCD, the
+// upper bits of the product mix all of them
+uint16_t MeterRegistry::home(uint32_t id)
+{
+  return (uint32_t)(id * 2654435761u) >> 16 & (SLOTS - 1);
+}
+
+bool MeterRegistry::add(uint32_t id, const uint8_t *key)
+{
+  if (id == 0)
+  {
+    return false;
+  }
+
+  uint16_t i = home(id);
+  uint16_t probes = 1;
+  while (ids[i] != 0 && ids[i] != id)
+  {
+    i = (i + 1) & (SLOTS - 1);
+    probes++;
+  }
+
+  if (ids[i] == 0)
+  {
+    if (count >= METER_MAX)
+    {
+      return false;
+    }
+    ids[i] = id;
+    index[i] = count++;
+  }
+
+  MeterEntry &m = entries[index[i]];
+  m.id = id;
+  memcpy(m.key, key, sizeof(m.key));
+  m.cipher.setKey(m.key, sizeof(m.key));
+  m.state = MeterState();
+#if METER_HOT
+  if (m.hot != METER_COLD)
+  {
+    hotCiphers[m.hot].setKey(m.key, sizeof(m.key));
+  }
+#endif
+  if (probes > maxProbes) maxProbes = probes;
+  return true;
+}
+
+MeterEntry *MeterRegistry::find(uint32_t id)
+{
+  uint16_t i = home(id);
+
+  while (ids[i] != id)
+  {
+    if (ids[i] == 0)
+    {
+      return nullptr;
+    }
+    i = (i + 1) & (SLOTS - 1);
+  }
+  return id ? &entries[index[i]] : nullptr;
+}
+
+BlockCipher *MeterRegistry::cipher(MeterEntry &meter)
+{
+  if (meter.heat < 0xFF) meter.heat++;
+  if (++heatFrames >= METER_HEAT_DECAY)
+  {
+    heatFrames = 0;
+    for (uint16_t i = 0; i < count; i++)
+    {
+      entries[i].heat /= 2;
+    }
+  }
+
+#if METER_HOT
+  if (meter.hot != METER_COLD)
+  {
+    keyStats.hot++;
+    return &hotCiphers[meter.hot];
+  }
+
+  // a free expanded schedule, or the one of the coldest hot meter
+  uint16_t slot = 0;
+  for (uint16_t i = 0; i < METER_HOT; i++)
+  {
+    if (hotOwner[i] == nullptr)
+    {
+      slot = i;
+      break;
+    }
+    if (hotOwner[i]->heat < hotOwner[slot]->heat) slot = i;
+  }
+
+  // only for a meter heard more than twice as often, similar ones
+  // would take turns and expand their key each time
+  MeterEntry *owner = hotOwner[slot];
+  if (owner == nullptr || 2 * owner->heat + 1 < meter.heat)
+  {
+    if (owner) owner->hot = METER_COLD;
+    hotOwner[slot] = &meter;
+    meter.hot = slot;
+    hotCiphers[slot].setKey(meter.key, sizeof(meter.key));
+    keyStats.expansions++;
+    keyStats.hot++;
+    return &hotCiphers[slot];
+  }
+#endif
+
+  keyStats.cold++;
+  return &meter.cipher;
+}
@@ -0,0 +1,108 @@
+#include "ModeScheduler.h"
+
+const RadioProfile ModeScheduler::modes[] = { RX_MODES };
+const uint8_t ModeScheduler::modeCount = sizeof(modes) / sizeof(modes[0]);
+
+ModeScheduler::ModeScheduler(void)
+  : active (modes[0])
+{
+}
+
+void ModeScheduler::frame(uint32_t id, RadioProfile p, uint32_t syncTime)
+{
+  Meter *entry = &meters[0];
+
+  for (uint8_t i = 0; i < RX_MODE_METERS; i++)
+  {
+    if (meters[i].id == id && meters[i].profile == p)
+    {
+      entry = &meters[i];
+      break;
+    }
+
+    // otherwise a free entry, or the one not heard for the longest time
+    if (entry->id != 0 &&
+        (meters[i].id == 0 || syncTime - meters[i].lastSeen > syncTime - entry->lastSeen))
+    {
+      entry = &meters[i];
+    }
+  }
+
+  if (entry->id != id || entry->profile != p)
+  {
+    entry->id = id;
+    entry->profile = p;
+    entry->timing = RxScheduler();
+  }
+
+  entry->timing.frame(syncTime);
+  entry->lastSeen = syncTime;
+  stats[p].frames++;
+}
+
+RadioProfile ModeScheduler::select(uint32_t now)
+{
+  RadioProfile next = active;
+  bool due = false;
+
+  // listening time of the profile that was active until now
+  listenMicros += now - lastSelect;
+  lastSelect = now;
+  stats[active].listenMillis += listenMicros / 1000;
+  listenMicros %= 1000;
+
+  // a learned window is open, the first one wins
+  for (uint8_t i = 0; i < RX_MODE_METERS; i++)
+  {
+    Meter &m = meters[i];
+    if (m.id == 0) continue;
+
+    uint32_t windows = m.timing.getWindows();
+    uint32_t misses = m.timing.getMisses();
+    bool open = m.timing.listen(now) && m.timing.isLocked();
+
+    stats[m.profile].windows += m.timing.getWindows() - windows;
+    stats[m.profile].misses += m.timing.getMisses() - misses;
+
+    if (open && !due)
+    {
+      next = m.profile;
+      due = true;
+    }
+  }
+
+  // otherwise take turns
+  if (!due && now - turnStart > dwell)
+  {
+    turn = (turn + 1) % modeCount;
+    turnStart = now;
+    next = modes[turn];
+
+    seed ^= seed << 13; // xorshift32
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    dwell = RX_MODE_DWELL / 2 + seed % RX_MODE_DWELL;
+  }
+
+  active = next;
+  return active;
+}
+
+int ModeScheduler::toJson(char *buf, size_t len) const
+{
+  int n = snprintf(buf, len, "{");
+
+  for (uint8_t i = 0; i < modeCount; i++)
+  {
+    const ModeStats &s = stats[modes[i]];
+    uint32_t perHour = s.listenMillis ? (uint64_t)s.frames * 3600000UL / s.listenMillis : 0;
+
+    n += snprintf(buf + n, n < (int)len ? len - n : 0,
+                  "%s\"%s\":{\"frames\":%u,\"listen_s\":%u,\"per_hour\":%u,\"windows\":%u,\"misses\":%u}",
+                  i ? "," : "", Cc1101Radio::profileName(modes[i]), s.frames,
+                  s.listenMillis / 1000, perHour, s.windows, s.misses);
+  }
+
+  n += snprintf(buf + n, n < (int)len ? len - n : 0, "}");
+  return n;
+}
@@ -0,0 +1,124 @@
+#include "RxScheduler.h"
+
+uint32_t RxScheduler::margin(void) const
+{
+  uint32_t m = jitter * RX_WINDOW_JITTER;
+  return m > RX_WINDOW_MARGIN ? m : RX_WINDOW_MARGIN;
+}
+
+void RxScheduler::setListening(bool listen, uint32_t now)
+{
+  if (listen == listening)
+  {
+    return;
+  }
+
+  if (listen)
+  {
+    sleepMillis += (now - changed) / 1000;
+  }
+  listening = listen;
+  changed = now;
+}
+
+void RxScheduler::frame(uint32_t syncTime)
+{
+  uint32_t delta = syncTime - anchor;
+  bool first = interval == 0 && consistent == 0 && anchor == 0;
+
+  // first frame, or not heard for too long: start over
+  if (first || delta > RX_WINDOW_MAX)
+  {
+    anchor = syncTime;
+    interval = 0;
+    consistent = 0;
+    locked = false;
+    return;
+  }
+
+  // second frame, or a shorter interval than we thought
+  if (interval == 0 || delta < interval / 2)
+  {
+    anchor = syncTime;
+    interval = delta;
+    jitter = 0;
+    consistent = 0;
+    locked = false;
+    return;
+  }
+
+  // frames may have been missed in between
+  uint32_t n = (delta + interval / 2) / interval;
+  int32_t error = (int32_t)(delta - n * interval);
+  uint32_t deviation = abs(error);
+
+  if (deviation > interval / 8)
+  {
+    // doesn't fit, learn again from this interval
+    anchor = syncTime;
+    interval = delta;
+    jitter = 0;
+    consistent = 0;
+    locked = false;
+    return;
+  }
+
+  // the anchor follows the frames smoothed, so the jitter of a single
+  // frame doesn't shift the next window
+  anchor += n * interval + error / RX_WINDOW_GAIN;
+  interval += error / (int32_t)(n * RX_WINDOW_DRIFT);
+  if (consistent < RX_WINDOW_LEARN)
+  {
+    // the largest deviation while learning, the average after
+    if (deviation > jitter) jitter = deviation;
+    consistent++;
+  }
+  else
+  {
+    jitter += ((int32_t)deviation - (int32_t)jitter) / RX_WINDOW_GAIN;
+  }
+
+  // only worth it, if the receiver is off for at least half of the time
+  locked = consistent >= RX_WINDOW_LEARN && 2 * margin() + RX_WINDOW_FRAME < interval / 2;
+}
+
+bool RxScheduler::listen(uint32_t now)
+{
+  if (!locked)
+  {
+    setListening(true, now);
+    return true;
+  }
+
+  uint32_t expected = anchor + interval;
+  int32_t untilOpen = (int32_t)(expected - margin() - now);
+  int32_t sinceClose = (int32_t)(now - (expected + margin() + RX_WINDOW_FRAME));
+
+  if (untilOpen > 0)
+  {
+    setListening(false, now);
+    return false;
+  }
+
+  if (sinceClose < 0)
+  {
+    if (!listening) windows++;
+    setListening(true, now);
+    return true;
+  }
+
+  // window closed without a frame, continuous RX until heard again
+  misses++;
+  locked = false;
+  setListening(true, now);
+  return true;
+}
+
+int RxScheduler::toJson(char *buf, size_t len) const
+{
+  return snprintf(buf, len,
+                  "{\"locked\":%s,\"interval_ms\":%u,\"jitter_us\":%u,"
+                  "\"windows\":%u,\"misses\":%u,\"asleep_s\":%u}",
+                  locked ? "true" : "false", interval / 1000, jitter,
+                  windows, misses, sleepMillis / 1000);
+}
@@ -14,301 +14,130 @@
 
 #include "WaterMeter.h"
 
-WaterMeter::WaterMeter(PubSubClient &mqtt)
-  : mqttClient  (mqtt)
-  , mqttEnabled (false)
-{
-}
-
-void WaterMeter::enableMqtt(bool enabled)
-{
-  mqttEnabled = enabled;
-}
-
-// ChipSelect assert
-inline void WaterMeter::selectCC1101(void)
-{
-#if defined(ESP32)
-  digitalWrite(CC1101_CS, LOW);
-#else
-  digitalWrite(SS, LOW);
-#endif
-}
-
-// ChipSelect deassert
-inline void WaterMeter::deselectCC1101(void)
-{
-#if defined(ESP32)
-  digitalWrite(CC1101_CS, HIGH);
-#else
-  digitalWrite(SS, HIGH);
-#endif
-}
-
-// wait for MISO pulling down
-inline void WaterMeter::waitMiso(void)
-{
+RadioUnit::RadioUnit(uint8_t cs, uint8_t gdo0, uint8_t gdo2)
 #if defined(ESP32)
-  while (digitalRead(CC1101_MISO) == HIGH)
-    ;
+  : bus   (cs, CC1101_MISO, CC1101_MOSI, CC1101_SCK, gdo0, gdo2)
 #else
-  while (digitalRead(MISO) == HIGH)
-    ;
+  : bus   (cs, MISO, MOSI, SCK, gdo0, gdo2)
 #endif
-}
-
-// write a single register of CC1101
-void WaterMeter::writeReg(uint8_t regAddr, uint8_t value)
-{
-  selectCC1101();
-  waitMiso();            // Wait until MISO goes low
-  SPI.transfer(regAddr); // Send register address
-  SPI.transfer(value);   // Send value
-  deselectCC1101();
-}
-
-// send a strobe command to CC1101
-void WaterMeter::cmdStrobe(uint8_t cmd)
+  , radio (bus)
 {
-  selectCC1101();
-  delayMicroseconds(5);
-  waitMiso();        // Wait until MISO goes low
-  SPI.transfer(cmd); // Send strobe command
-  delayMicroseconds(5);
-  deselectCC1101();
 }
 
-// read CC1101 register (status or configuration)
-uint8_t WaterMeter::readReg(uint8_t regAddr, uint8_t regType)
+WaterMeter::WaterMeter(PubSubClient &mqtt)
+  : radios      { CC1101_RADIOS }
+  , mqttClient  (mqtt)
+  , mqttEnabled (false)
 {
-  uint8_t addr, val;
-
-  addr = regAddr | regType;
-  selectCC1101();
-  waitMiso();               // Wait until MISO goes low
-  SPI.transfer(addr);       // Send register address
-  val = SPI.transfer(0x00); // Read result
-  deselectCC1101();
-
-  return val;
+  for (RadioUnit &unit : radios)
+  {
+    merger.add(unit.radio.frames());
+  }
 }
 
-//
-void WaterMeter::readBurstReg(uint8_t *buffer, uint8_t regAddr, uint8_t len)
+void WaterMeter::enableMqtt(bool enabled)
 {
-  uint8_t addr, i;
-
-  addr = regAddr | READ_BURST;
-  selectCC1101();
-  delayMicroseconds(5);
-  waitMiso();         // Wait until MISO goes low
-  SPI.transfer(addr); // Send register address
-  for (i = 0; i < len; i++)
-    buffer[i] = SPI.transfer(0x00); // Read result byte by byte
-  delayMicroseconds(2);
-  deselectCC1101();
+  mqttEnabled = enabled;
 }
 
-// power on reset
-void WaterMeter::reset(void)
+// should be called frequently, does the frame checking and decryption
+void WaterMeter::loop(void)
 {
-  deselectCC1101();
-  delayMicroseconds(3);
-
-#if defined(ESP32)
-  digitalWrite(CC1101_MOSI, LOW);
-  digitalWrite(CC1101_SCK, HIGH); // see CC1101 datasheet 11.3
-#else
-  digitalWrite(MOSI, LOW);
-  digitalWrite(SCK, HIGH); // see CC1101 datasheet 11.3
+#if !defined(ESP32)
+  // no radio task, run the radios from here
+  for (RadioUnit &unit : radios)
+  {
+    unit.radio.tick();
+  }
 #endif
 
-  selectCC1101();
-  delayMicroseconds(3);
-  deselectCC1101();
-  delayMicroseconds(45); // at least 40 us
+  decode();
 
-  selectCC1101();
-
-  waitMiso();                // Wait until MISO goes low
-  SPI.transfer(CC1101_SRES); // Send reset command strobe
-  waitMiso();                // Wait until MISO goes low
-
-  deselectCC1101();
-}
+#if RX_MULTIMODE
+  // profile of the meter whose window is open, or the next one's turn
+  RadioProfile profile = modes.select(micros());
+  for (RadioUnit &unit : radios)
+  {
+    unit.radio.setProfile(profile);
+  }
+#endif
 
-// set IDLE state, flush FIFO and (re)start receiver
-void WaterMeter::startReceiver(void)
-{
-  uint8_t regCount = 0;
-  cmdStrobe(CC1101_SIDLE); // Enter IDLE state
-  while (readReg(CC1101_MARCSTATE, CC1101_STATUS_REGISTER) != MARCSTATE_IDLE)
+  // a missed receive window of our meter: the receiver may be deaf
+  uint32_t misses = scheduler.getMisses();
+  bool listen = scheduler.listen(micros());
+  if (scheduler.getMisses() != misses)
   {
-    if (regCount++ > 100)
+    for (RadioUnit &unit : radios)
     {
-      Serial.println("Enter idle state failed!\n");
-      restartRadio();
+      unit.radio.recover(RECOVER_CALIBRATE);
     }
   }
 
-  cmdStrobe(CC1101_SFRX); // flush receive queue
-  delay(5);
-
-  regCount = 0;
-  cmdStrobe(CC1101_SRX); // Enter RX state
-  delay(10);
-  while (readReg(CC1101_MARCSTATE, CC1101_STATUS_REGISTER) != MARCSTATE_RX)
+#if RX_WINDOWING
+  // receiver on only around the next expected frame of our meter
+  if (listen != listening)
   {
-    if (regCount++ > 100)
+    listening = listen;
+    for (RadioUnit &unit : radios)
     {
-      Serial.println("Enter RX state failed!\n");
-      restartRadio();
+      if (listen)
+        unit.radio.wake();
+      else
+        unit.radio.sleep();
     }
   }
-}
-
-// initialize all the CC1101 registers
-void WaterMeter::initializeRegisters(void)
-{
-  writeReg(CC1101_IOCFG2, CC1101_DEFVAL_IOCFG2);
-  writeReg(CC1101_IOCFG0, CC1101_DEFVAL_IOCFG0);
-  writeReg(CC1101_FIFOTHR, CC1101_DEFVAL_FIFOTHR);
-  writeReg(CC1101_PKTLEN, CC1101_DEFVAL_PKTLEN);
-  writeReg(CC1101_PKTCTRL1, CC1101_DEFVAL_PKTCTRL1);
-  writeReg(CC1101_PKTCTRL0, CC1101_DEFVAL_PKTCTRL0);
-  writeReg(CC1101_SYNC1, CC1101_DEFVAL_SYNC1);
-  writeReg(CC1101_SYNC0, CC1101_DEFVAL_SYNC0);
-  writeReg(CC1101_ADDR, CC1101_DEFVAL_ADDR);
-  writeReg(CC1101_CHANNR, CC1101_DEFVAL_CHANNR);
-  writeReg(CC1101_FSCTRL1, CC1101_DEFVAL_FSCTRL1);
-  writeReg(CC1101_FSCTRL0, CC1101_DEFVAL_FSCTRL0);
-  writeReg(CC1101_FREQ2, CC1101_DEFVAL_FREQ2);
-  writeReg(CC1101_FREQ1, CC1101_DEFVAL_FREQ1);
-  writeReg(CC1101_FREQ0, CC1101_DEFVAL_FREQ0);
-  writeReg(CC1101_MDMCFG4, CC1101_DEFVAL_MDMCFG4);
-  writeReg(CC1101_MDMCFG3, CC1101_DEFVAL_MDMCFG3);
-  writeReg(CC1101_MDMCFG2, CC1101_DEFVAL_MDMCFG2);
-  writeReg(CC1101_MDMCFG1, CC1101_DEFVAL_MDMCFG1);
-  writeReg(CC1101_MDMCFG0, CC1101_DEFVAL_MDMCFG0);
-  writeReg(CC1101_DEVIATN, CC1101_DEFVAL_DEVIATN);
-  writeReg(CC1101_MCSM1, CC1101_DEFVAL_MCSM1);
-  writeReg(CC1101_MCSM0, CC1101_DEFVAL_MCSM0);
-  writeReg(CC1101_FOCCFG, CC1101_DEFVAL_FOCCFG);
-  writeReg(CC1101_BSCFG, CC1101_DEFVAL_BSCFG);
-  writeReg(CC1101_AGCCTRL2, CC1101_DEFVAL_AGCCTRL2);
-  writeReg(CC1101_AGCCTRL1, CC1101_DEFVAL_AGCCTRL1);
-  writeReg(CC1101_AGCCTRL0, CC1101_DEFVAL_AGCCTRL0);
-  writeReg(CC1101_FREND1, CC1101_DEFVAL_FREND1);
-  writeReg(CC1101_FREND0, CC1101_DEFVAL_FREND0);
-  writeReg(CC1101_FSCAL3, CC1101_DEFVAL_FSCAL3);
-  writeReg(CC1101_FSCAL2, CC1101_DEFVAL_FSCAL2);
-  writeReg(CC1101_FSCAL1, CC1101_DEFVAL_FSCAL1);
-  writeReg(CC1101_FSCAL0, CC1101_DEFVAL_FSCAL0);
-  writeReg(CC1101_FSTEST, CC1101_DEFVAL_FSTEST);
-  writeReg(CC1101_TEST2, CC1101_DEFVAL_TEST2);
-  writeReg(CC1101_TEST1, CC1101_DEFVAL_TEST1);
-  writeReg(CC1101_TEST0, CC1101_DEFVAL_TEST0);
-}
-
-IRAM_ATTR void WaterMeter::instanceCC1101Isr()
-{
-  // set the flag that a package is available
-  packetAvailable = true;
-}
-
-// static ISR method, that calls the right instance
-IRAM_ATTR void WaterMeter::cc1101Isr(void *p)
-{
-  WaterMeter *ptr = (WaterMeter *)p;
-  ptr->instanceCC1101Isr();
-}
-
-// should be called frequently, handles the ISR flag
-// does the frame checkin and decryption
-void WaterMeter::loop(void)
-{
-  static unsigned long lastDebugOutput = 0;
+#else
+  (void)listen;
+#endif
 
-  // Check for packets via interrupt (GDO0 connected to GPIO3)
-  if (packetAvailable)
+  if (millis() - lastLinkPublish > LINK_PUBLISH_INTERVAL)
   {
-    //  Disable wireless reception interrupt
-    detachInterrupt(digitalPinToInterrupt(CC1101_GDO0));
-
-    // clear the flag
-    packetAvailable = false;
-    receive();
-
-    // Enable wireless reception interrupt
-    attachInterruptArg(digitalPinToInterrupt(CC1101_GDO0), cc1101Isr, this, FALLING);
+    lastLinkPublish = millis();
+    publishLinkStats();
   }
 
-  // Periodic debug output every 10 seconds
-  if (millis() - lastDebugOutput > 10000)
+#if defined(ESP32)
+  // the CC1101 is next to the ESP, its temperature decides about recalibration
+  if (millis() - lastTemperature > TEMPERATURE_INTERVAL)
   {
-    lastDebugOutput = millis();
-    uint8_t marcState = readReg(CC1101_MARCSTATE, CC1101_STATUS_REGISTER);
-    uint8_t rxBytes = readReg(CC1101_RXBYTES, CC1101_STATUS_REGISTER);
-    uint8_t rssi = readReg(CC1101_RSSI, CC1101_STATUS_REGISTER);
-
-    Serial.printf("CC1101 Status - MARC: 0x%02X, RX bytes: %d, RSSI: %d dBm\n",
-                  marcState, rxBytes & 0x7F, (rssi >= 128) ? (rssi - 256) / 2 - 74 : rssi / 2 - 74);
-
-    // Check if we're still in RX mode
-    if (marcState != MARCSTATE_RX)
-    {
-      Serial.printf("Not in RX mode (state: 0x%02X), restarting receiver...\n", marcState);
-      startReceiver();
-    }
-
-    // Check for FIFO overflow (shouldn't happen with proper GDO0 interrupt handling)
-    if (rxBytes & 0x80)
+    lastTemperature = millis();
+    int16_t celsius = temperatureRead();
+    for (RadioUnit &unit : radios)
     {
-      Serial.println("Warning: RX FIFO overflow detected! Restarting receiver...");
-      startReceiver();
+      unit.radio.setTemperature(celsius);
     }
   }
+#endif
 
   if (millis() - lastFrameReceived > RECEIVE_TIMEOUT)
   {
-    // workaround: reset CC1101, since it stops receiving from time to time
-    Serial.println("Receive timeout, restarting radio...");
-    restartRadio();
+    // CC1101 stops receiving from time to time: check the radios now,
+    // they only recover on a symptom, maybe no meter is in range
+    Serial.println("Receive timeout, checking radio...");
+    for (RadioUnit &unit : radios)
+    {
+      unit.radio.checkHealth();
+    }
+    lastFrameReceived = millis();
   }
 }
 
 // Initialize CC1101 to receive WMBus MODE C1
 void WaterMeter::begin(uint8_t *key, uint8_t *id)
 {
-  pinMode(SS, OUTPUT);         // SS Pin -> Output
-  SPI.begin();                 // Initialize SPI interface
-  pinMode(CC1101_GDO0, INPUT); // Config GDO0 as input
-
-  memcpy(aesKey, key, sizeof(aesKey));
-  aes128.setKey(aesKey, sizeof(aesKey));
-  pinMode(SS, OUTPUT);                // SS Pin -> Output
-  memcpy(meterId, id, sizeof(meterId));
-
-
-  attachInterruptArg(digitalPinToInterrupt(CC1101_GDO0), cc1101Isr, this, FALLING);
-  lastFrameReceived = millis();
-}
-
-void WaterMeter::restartRadio()
-{
-  Serial.println("Resetting CC1101...");
-  Serial.printf("GDO0 interrupt pin configured on GPIO%d\n", CC1101_GDO0);
+  meterId = (uint32_t)id[0] << 24 | id[1] << 16 | id[2] << 8 | id[3];
+  addMeter(meterId, key);
 
-  reset(); // power on CC1101
-
-  initializeRegisters(); // init CC1101 registers
-
-  cmdStrobe(CC1101_SCAL);
-  delay(1);
-
-  startReceiver();
+  // all chip selects high before the first CC1101 is reset
+  for (RadioUnit &unit : radios)
+  {
+    unit.bus.begin();
+  }
+  for (RadioUnit &unit : radios)
+  {
+    unit.radio.begin();
+  }
   lastFrameReceived = millis();
-  Serial.println("CC1101 ready for WMBus reception");
 }
 
 bool WaterMeter::checkFrame(void)
@@ -324,15 +153,13 @@ bool WaterMeter::checkFrame(void)
 #endif
 
   // check meterId
-  for (uint8_t i = 0; i < 4; i++)
+  uint32_t id = payload[4] | payload[5] << 8 | payload[6] << 16 | (uint32_t)payload[7] << 24;
+  if (meters.find(id) == nullptr)
   {
-    if (meterId[i] != payload[7 - i])
-    {
 #if DEBUG
-      Serial.println("Meter serial doesnt match!");
+    Serial.println("Meter serial doesnt match!");
 #endif
-      return false;
-    }
+    return false;
   }
 
 #if DEBUG
@@ -344,17 +171,28 @@ bool WaterMeter::checkFrame(void)
   Serial.println();
 #endif
 
-  uint16_t crc = crcEN13575(payload, length - 1); // -2 (CRC) + 1 (L-field)
-  if (crc != (payload[length - 1] << 8 | payload[length]))
+  // checked by the radio while draining the frame
+  if (!crcOk)
   {
     Serial.println("CRC Error");
-    Serial.printf("%04x - %02x%02x\n", crc, payload[length - 1], payload[length]);
+    Serial.printf("%02x%02x\n", payload[length - 1], payload[length]);
     return false;
   }
 
   return true;
 }
 
+bool WaterMeter::addMeter(uint32_t id, const uint8_t *key)
+{
+  if (!meters.add(id, key))
+  {
+    Serial.printf("Meter %08x not added, %u of %u meters registered\n",
+                  id, meters.size(), meters.capacity());
+    return false;
+  }
+  return true;
+}
+
 // Publish Home Assistant MQTT Discovery configuration
 void WaterMeter::publishHomeAssistantDiscovery(void)
 {
@@ -525,36 +363,42 @@ void WaterMeter::publishAvailability(bool online)
 #endif
 }
 
-void WaterMeter::getMeterInfo(uint8_t *data, size_t len)
+void WaterMeter::getMeterInfo(const TelegramView &telegram, MeterState &state)
 {
-  // init positions for compact frame
-  int pos_tt = 9;  // total consumption
-  int pos_tg = 13; // target consumption
-  int pos_ic = 7;  // info codes
-  int pos_ft = 17; // flow temp
-  int pos_at = 18; // ambient temp
+  state.totalWater = telegram.totalWater();
+  state.targetWater = telegram.targetWater();
+  state.flowTemp = telegram.flowTemp();
+  state.ambientTemp = telegram.ambientTemp();
+  state.infoCodes = telegram.infoCodes();
+  state.frames++;
+  state.lastSeen = millis();
+}
 
-  if (data[2] == 0x78) // long frame
+void WaterMeter::publishMeterInfo(const MeterEntry &meter)
+{
+  // the other meters: their values as one JSON object
+  if (meter.id != meterId)
   {
-    // overwrite it with long frame positions
-    pos_tt = 10;
-    pos_tg = 16;
-    pos_ic = 6;
-    pos_ft = 22;
-    pos_at = 25;
-  }
-
-  totalWater = data[pos_tt] + (data[pos_tt + 1] << 8) + (data[pos_tt + 2] << 16) + (data[pos_tt + 3] << 24);
+    char topic[64];
+    char json[160];
 
-  targetWater = data[pos_tg] + (data[pos_tg + 1] << 8) + (data[pos_tg + 2] << 16) + (data[pos_tg + 3] << 24);
+    meter.state.toJson(json, sizeof(json));
+    Serial.printf("Meter %08x %s\n", meter.id, json);
+    if (mqttEnabled)
+    {
+      snprintf(topic, sizeof(topic), MQTT_PREFIX MQTT_meter "%08x", meter.id);
+      mqttClient.publish(topic, json);
+      mqttClient.loop();
+    }
+    return;
+  }
 
-  flowTemp = data[pos_ft];
-  ambientTemp = data[pos_at];
-  infoCodes = data[pos_ic];
-}
+  uint32_t totalWater = meter.state.totalWater;
+  uint32_t targetWater = meter.state.targetWater;
+  uint8_t flowTemp = meter.state.flowTemp;
+  uint8_t ambientTemp = meter.state.ambientTemp;
+  uint8_t infoCodes = meter.state.infoCodes;
 
-void WaterMeter::publishMeterInfo()
-{
   char total[12];
   snprintf(total, sizeof(total), "%d.%03d", totalWater/ 1000, totalWater % 1000);
   Serial.printf("total: %s m%c - ", total, 179);
@@ -627,93 +471,254 @@ void WaterMeter::publishMeterInfo()
   mqttClient.publish(MQTT_PREFIX MQTT_atemp, ambient_temp_json);
   mqttClient.publish(MQTT_PREFIX MQTT_info, info_codes_mqtt);
   mqttClient.loop();
-}
 
-// reads a single byte from the RX fifo
-uint8_t WaterMeter::readByteFromFifo(void)
-{
-  return readReg(CC1101_RXFIFO, CC1101_CONFIG_REGISTER);
+  char rssi_json[8];
+  snprintf(rssi_json, sizeof(rssi_json), "%d", link.rssi);
+
+  char lqi_json[8];
+  snprintf(lqi_json, sizeof(lqi_json), "%d", link.lqi);
+
+  mqttClient.publish(MQTT_PREFIX MQTT_rssi, rssi_json);
+  mqttClient.publish(MQTT_PREFIX MQTT_lqi, lqi_json);
+  mqttClient.loop();
 }
 
-// handles a received frame and restart the CC1101 receiver
-void WaterMeter::receive()
+// rolling link quality of all meters heard, for placing the receiver,
+// the frequency correction, recoveries, capture rates per mode and receive windows
+void WaterMeter::publishLinkStats(void)
 {
-  // read preamble
-  uint8_t p1 = readByteFromFifo();
-  uint8_t p2 = readByteFromFifo();
+  char topic[64];
+  char json[512];
+
+  for (uint8_t i = 0; i < links.size(); i++)
+  {
+    const LinkStats &meter = links[i];
+    if (meter.id == 0) continue;
 
+    meter.toJson(json, sizeof(json));
 #if DEBUG >= 1
-  Serial.printf("Packet received - Preamble: %02X%02X", p1, p2);
+    Serial.printf("Link %s\n", json);
 #endif
 
-  // get length
-  payload[0] = readByteFromFifo();
+    if (mqttEnabled)
+    {
+      snprintf(topic, sizeof(topic), MQTT_PREFIX MQTT_link "%08x", meter.id);
+      mqttClient.publish(topic, json);
+      mqttClient.loop();
+    }
+  }
 
 #if DEBUG >= 1
-  Serial.printf(" Length: %02X", payload[0]);
+  const KeyCacheStats &keys = meters.getKeyStats();
+  Serial.printf("Meters - registered: %u, frames with expanded keys: %u, small: %u, key expansions: %u\n",
+                meters.size(), keys.hot, keys.cold, keys.expansions);
 #endif
 
-  if (payload[0] < MAX_LENGTH)
+  for (uint8_t i = 0; i < RADIO_COUNT; i++)
   {
-    // Read the rest of the data regardless of preamble
-    for (int i = 0; i < payload[0] && i < MAX_LENGTH - 1; i++)
+    radios[i].afc.toJson(json, sizeof(json));
+#if DEBUG >= 1
+    Serial.printf("AFC %d %s\n", i, json);
+#endif
+    if (mqttEnabled)
     {
-      payload[i + 1] = readByteFromFifo();
+      if (i == 0)
+        snprintf(topic, sizeof(topic), MQTT_PREFIX MQTT_afc);
+      else
+        snprintf(topic, sizeof(topic), MQTT_PREFIX MQTT_afc "/%d", i);
+      mqttClient.publish(topic, json);
+      mqttClient.loop();
     }
 
-#if DEBUG >= 2
-    // Show raw packet data only in verbose mode
-    Serial.printf(" Raw packet (%d bytes): ", payload[0] + 3);
-    Serial.printf("%02X%02X%02X", p1, p2, payload[0]);
-    for (int i = 0; i < payload[0] && i < MAX_LENGTH - 1; i++)
+    radios[i].radio.recoveryToJson(json, sizeof(json));
+#if DEBUG >= 1
+    Serial.printf("Recovery %d %s\n", i, json);
+#endif
+    if (mqttEnabled)
     {
-      Serial.printf("%02X", payload[i + 1]);
+      if (i == 0)
+        snprintf(topic, sizeof(topic), MQTT_PREFIX MQTT_recovery);
+      else
+        snprintf(topic, sizeof(topic), MQTT_PREFIX MQTT_recovery "/%d", i);
+      mqttClient.publish(topic, json);
+      mqttClient.loop();
     }
-    Serial.println();
-#endif
 
-    // Try to process any packet that looks like WMBus
-    if (payload[0] >= 10) // Minimum reasonable packet size for WMBus
+    radios[i].radio.wakeupsToJson(json, sizeof(json));
+#if DEBUG >= 1
+    Serial.printf("Wakeups %d %s\n", i, json);
+#endif
+    if (mqttEnabled)
     {
+      if (i == 0)
+        snprintf(topic, sizeof(topic), MQTT_PREFIX MQTT_wakeups);
+      else
+        snprintf(topic, sizeof(topic), MQTT_PREFIX MQTT_wakeups "/%d", i);
+      mqttClient.publish(topic, json);
+      mqttClient.loop();
+    }
+  }
+
+#if RADIO_COUNT > 1
+  merger.toJson(json, sizeof(json));
 #if DEBUG >= 1
-      Serial.println(" - Processing...");
+  Serial.printf("Diversity %s\n", json);
+#endif
+  if (mqttEnabled)
+  {
+    mqttClient.publish(MQTT_PREFIX MQTT_diversity, json);
+    mqttClient.loop();
+  }
 #endif
 
-      // 3rd byte is payload length
-      length = payload[0];
+#if RX_MULTIMODE
+  modes.toJson(json, sizeof(json));
+#if DEBUG >= 1
+  Serial.printf("Modes %s\n", json);
+#endif
+  if (mqttEnabled)
+  {
+    mqttClient.publish(MQTT_PREFIX MQTT_modes, json);
+    mqttClient.loop();
+  }
+#endif
 
-      // Try to decrypt and process the packet
-      if (processWMBusPacket())
-      {
+#if RX_WINDOWING
+  scheduler.toJson(json, sizeof(json));
 #if DEBUG >= 1
-        Serial.println("✓ Packet successfully processed!");
+  Serial.printf("RX window %s\n", json);
 #endif
-        lastPacketDecoded = millis();
-        lastFrameReceived = millis();
-      }
-      else
-      {
+  if (mqttEnabled)
+  {
+    mqttClient.publish(MQTT_PREFIX MQTT_window, json);
+    mqttClient.loop();
+  }
+#endif
+}
+
+// decode stage: processes the oldest frame from the radio queues
+void WaterMeter::decode()
+{
+  RawFrame *frame = merger.front(micros());
+  if (frame == nullptr)
+  {
+    return;
+  }
+
+  if (frame->profile == PROFILE_T1)
+  {
+    decodeModeT(frame);
+    merger.pop();
+    return;
+  }
+
+  payload = &frame->data[2];
+
 #if DEBUG >= 1
-        Serial.println("✗ Packet processing failed");
+  Serial.printf("Packet received - Preamble: %02X%02X", frame->data[0], frame->data[1]);
+  Serial.printf(" Length: %02X RSSI: %d dBm", payload[0], frame->rssi);
+#endif
+
+#if DEBUG >= 2
+  // Show raw packet data only in verbose mode
+  Serial.printf(" Raw packet (%d bytes): ", frame->length);
+  for (int i = 0; i < frame->length; i++)
+  {
+    Serial.printf("%02X", frame->data[i]);
+  }
+  Serial.println();
+#endif
+
+  // Try to process any packet that looks like WMBus
+  if (payload[0] >= 10) // Minimum reasonable packet size for WMBus
+  {
+#if DEBUG >= 1
+    Serial.println(" - Processing...");
+#endif
+
+    // index of the last byte, the L-field without the CRC the radio
+    // removed from a long frame
+    length = frame->length - 3;
+
+    link.rssi = frame->rssi;
+    link.lqi = frame->lqi;
+    link.freqEst = frame->freqEst;
+    freqOffset = frame->freqOffset;
+    rxRadio = frame->radio;
+#if DEBUG >= 1
+    Serial.printf("LQI: %d, FREQEST: %d\n", link.lqi, link.freqEst);
+#endif
+
+    // link quality of every meter with a valid frame, not only ours
+    // the radio checked the CRC while draining, format A frames arrive
+    // with their block CRCs removed
+    crcBytes = frame->formatA ? 0 : 2;
+    crcOk = frame->crcOk;
+    radios[rxRadio].radio.frameChecked(crcOk);
+    uint32_t id = payload[4] | payload[5] << 8 | payload[6] << 16 | (uint32_t)payload[7] << 24;
+    if (crcOk)
+    {
+      links.update(id, link, millis());
+#if RX_MULTIMODE
+      modes.frame(id, (RadioProfile)frame->profile, frame->syncTime);
 #endif
-      }
     }
+
+    // Try to decrypt and process the packet
+    if (processWMBusPacket())
+    {
+      latency.add(micros() - frame->syncTime);
+      // the receive windows follow our meter
+      if (id == meterId)
+      {
+        scheduler.frame(frame->syncTime);
+      }
 #if DEBUG >= 1
+      Serial.printf("✓ Packet successfully processed! (latency: %u us, avg: %u us)\n",
+                    latency.last, latency.avg());
+#endif
+      lastPacketDecoded = millis();
+      lastFrameReceived = millis();
+    }
     else
     {
-      Serial.println(" - Packet too short, ignoring");
-    }
+#if DEBUG >= 1
+      Serial.println("✗ Packet processing failed");
 #endif
+    }
   }
+#if DEBUG >= 1
   else
   {
-#if DEBUG >= 1
-    Serial.printf(" Invalid length: %d (max: %d)\n", payload[0], MAX_LENGTH);
-#endif
+    Serial.println(" - Packet too short, ignoring");
   }
+#endif
+
+  payload = nullptr;
+  merger.pop();
+}
+
+// mode T frame, format A decoded and its block CRCs checked by the radio
+// already, for the link quality and the receive timetable of the meter
+void WaterMeter::decodeModeT(RawFrame *frame)
+{
+  uint8_t *block = frame->data;
+
+  radios[frame->radio].radio.frameChecked(true);
+
+  uint32_t id = block[4] | block[5] << 8 | block[6] << 16 | (uint32_t)block[7] << 24;
+
+  link.rssi = frame->rssi;
+  link.lqi = frame->lqi;
+  link.freqEst = frame->freqEst;
+  links.update(id, link, millis());
+#if RX_MULTIMODE
+  modes.frame(id, (RadioProfile)frame->profile, frame->syncTime);
+#endif
 
-  // flush RX fifo and restart receiver
-  startReceiver();
+#if DEBUG >= 1
+  Serial.printf("T1 frame - ID: %08x, L: %d, RSSI: %d dBm\n", id, block[0], frame->rssi);
+#endif
 }
 
 // Process and decrypt WMBus packet regardless of preamble
@@ -724,34 +729,18 @@ bool WaterMeter::processWMBusPacket(void)
   Serial.printf("Processing packet - Length: %d bytes\n", length);
 #endif
 
-  // Check if this packet is for our meter
+  // Check if this packet is for one of our meters
+  MeterEntry *meter = nullptr;
   if (length >= 8)
   {
-    bool meterMatch = true;
-    for (uint8_t i = 0; i < 4; i++)
-    {
-      if (meterId[i] != payload[7 - i])
-      {
-        meterMatch = false;
-        break;
-      }
-    }
+    uint32_t id = payload[4] | payload[5] << 8 | payload[6] << 16 | (uint32_t)payload[7] << 24;
+    meter = meters.find(id);
 
-    if (!meterMatch)
+    if (meter == nullptr)
     {
 #if DEBUG >= 2
-      // Print meter ID comparison only in verbose mode
-      Serial.printf("Packet meter ID: ");
-      for (uint8_t i = 0; i < 4; i++)
-      {
-        Serial.printf("%02X", payload[7-i]);
-      }
-      Serial.printf(" (expected: ");
-      for (uint8_t i = 0; i < 4; i++)
-      {
-        Serial.printf("%02X", meterId[i]);
-      }
-      Serial.println(") - skipping");
+      // Print meter ID only in verbose mode
+      Serial.printf("Packet meter ID: %08X (%u meters registered) - skipping\n", id, meters.size());
 #endif
       return false;
     }
@@ -777,36 +766,34 @@ bool WaterMeter::processWMBusPacket(void)
     return false;
   }
 
-  // Calculate CRC and verify
-  uint16_t crc = crcEN13575(payload, length - 1); // -2 (CRC) + 1 (L-field)
-  uint16_t packetCrc = (payload[length - 1] << 8) | payload[length];
-
-  if (crc != packetCrc)
+  // CRC verdict of the radio, format A was checked per block
+  if (!crcOk)
   {
+    radios[rxRadio].afc.crcError();
 #if DEBUG >= 1
-    Serial.printf("CRC mismatch: calculated=0x%04X, packet=0x%04X\n", crc, packetCrc);
+    Serial.printf("CRC mismatch: packet=0x%02X%02X\n", payload[length - 1], payload[length]);
 #endif
     return false;
   }
 
 #if DEBUG >= 2
-  Serial.printf("CRC OK (0x%04X) - attempting decryption\n", crc);
+  Serial.println("CRC OK - attempting decryption");
 #endif
 
-  // Extract cipher data (starts at index 17, after header)
-  uint8_t cipherLength = length - 2 - 16; // cipher starts at index 16, remove 2 crc bytes
-  if (cipherLength > MAX_LENGTH - 17)
+  // keep the receiver centred on our meter
+  RadioUnit &unit = radios[rxRadio];
+  if (meter->id == meterId && unit.afc.add(link.freqEst, freqOffset))
   {
-#if DEBUG >= 1
-    Serial.printf("Cipher too long: %d bytes\n", cipherLength);
-#endif
-    return false;
+    unit.radio.setFreqOffset(unit.afc.getOffset());
   }
 
-  memcpy(cipher, &payload[17], cipherLength);
+  // cipher data starts at index 17, after the header, up to the crc bytes
+  // it is decrypted in place, the frame isn't needed afterwards
+  uint8_t *cipher = &payload[17];
+  uint8_t cipherLength = length - crcBytes - 16;
 
   // Build IV for decryption
-  memset(iv, 0, sizeof(iv)); // padding with 0
+  uint8_t iv[16] = { 0 }; // padding with 0
   memcpy(iv, &payload[2], 8);  // M-field + A-field
   iv[8] = payload[11];         // CI-field
   memcpy(&iv[9], &payload[13], 4); // Access number + status + configuration
@@ -829,21 +816,31 @@ bool WaterMeter::processWMBusPacket(void)
 #endif
 
   // Decrypt the data
+  aes128.use(meters.cipher(*meter));
   aes128.setIV(iv, sizeof(iv));
-  aes128.decrypt(plaintext, (const uint8_t *)cipher, cipherLength);
+  aes128.decrypt(cipher, cipher, cipherLength);
+  TelegramView telegram(cipher, cipherLength);
 
 #if DEBUG >= 2
-  Serial.printf("Plaintext (%d bytes): ", cipherLength);
-  for (int i = 0; i < cipherLength; i++)
+  Serial.printf("Plaintext (%d bytes): ", telegram.size());
+  for (int i = 0; i < telegram.size(); i++)
   {
-    Serial.printf("%02X", plaintext[i]);
+    Serial.printf("%02X", telegram.bytes()[i]);
   }
   Serial.println();
 #endif
 
+  if (!telegram.valid())
+  {
+#if DEBUG >= 1
+    Serial.printf("Plaintext too short: %d bytes\n", telegram.size());
+#endif
+    return false;
+  }
+
   // Extract meter information from decrypted data
-  getMeterInfo(plaintext, cipherLength);
-  publishMeterInfo();
+  getMeterInfo(telegram, meter->state);
+  publishMeterInfo(*meter);
 
   return true;
 }
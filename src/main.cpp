@@ -269,6 +269,17 @@ void setup()
     uint8_t key[16] = { ENCRYPTION_KEY }; // AES-128 key
     uint8_t id[4] = { SERIAL_NUMBER }; // Multical21 serial number
     waterMeter.begin(key, id);  // Restored watermeter initialization
+
+#ifdef METERS
+    // more meters in range, their values go to MQTT_meter
+    static const struct { uint32_t id; uint8_t key[16]; } meters[] = { METERS };
+    static_assert(sizeof(meters) / sizeof(meters[0]) < METER_MAX,
+                  "more METERS than METER_MAX - 1, SERIAL_NUMBER takes one");
+    for (const auto &m : meters)
+    {
+        waterMeter.addMeter(m.id, m.key);
+    }
+#endif
 }
 
 enum ControlStateType
@@ -16,9 +16,92 @@ uint16_t crcX25(uint8_t *payload, uint16_t length)
    return crcInternal(payload, length, 0x1021, 0xffff, true, true);
 }
 
-uint16_t crcEN13575(uint8_t *payload, uint16_t length)
+// EN 13757 CRC tables, generated by the compiler: crcTable[0][n] is the
+// CRC register after byte n, crcTable[k][n] after byte n and k zero bytes
+static constexpr uint16_t CRC_POLY = 0x3D65;
+
+static constexpr uint16_t crcShift(uint16_t c, uint8_t bits)
+{
+  return bits == 0 ? c : crcShift((uint16_t)(c << 1) ^ (c & 0x8000 ? CRC_POLY : 0), bits - 1);
+}
+
+static constexpr uint16_t crcByte(uint16_t n)
+{
+  return crcShift(n << 8, 8);
+}
+
+static constexpr uint16_t crcSlice(uint8_t k, uint16_t n)
+{
+  return k == 0 ? crcByte(n) : (uint16_t)(crcSlice(k - 1, n) << 8) ^ crcByte(crcSlice(k - 1, n) >> 8);
+}
+
+#define CRC_4(k, n) crcSlice(k, n), crcSlice(k, n + 1), crcSlice(k, n + 2), crcSlice(k, n + 3)
+#define CRC_16(k, n) CRC_4(k, n), CRC_4(k, n + 4), CRC_4(k, n + 8), CRC_4(k, n + 12)
+#define CRC_64(k, n) CRC_16(k, n), CRC_16(k, n + 16), CRC_16(k, n + 32), CRC_16(k, n + 48)
+#define CRC_TABLE(k) { CRC_64(k, 0), CRC_64(k, 64), CRC_64(k, 128), CRC_64(k, 192) }
+
+static constexpr uint16_t crcTable[CRC_SLICE][256] =
+{
+  CRC_TABLE(0),
+#if CRC_SLICE >= 4
+  CRC_TABLE(1), CRC_TABLE(2), CRC_TABLE(3),
+#endif
+#if CRC_SLICE >= 8
+  CRC_TABLE(4), CRC_TABLE(5), CRC_TABLE(6), CRC_TABLE(7),
+#endif
+};
+
+static_assert(crcTable[0][1] == CRC_POLY, "CRC table");
+
+uint16_t crcEN13575Bytewise(uint16_t crc, const uint8_t *p, uint16_t length)
+{
+  while (length--)
+  {
+    crc = crc << 8 ^ crcTable[0][(crc >> 8) ^ *p++];
+  }
+  return crc;
+}
+
+#if CRC_SLICE >= 4
+// 4 bytes per step, the CRC register goes into the first two
+uint16_t crcEN13575Slice4(uint16_t crc, const uint8_t *p, uint16_t length)
 {
-   return crcInternal(payload, length, 0x3D65, 0x0000, false, false);
+  for (; length >= 4; length -= 4, p += 4)
+  {
+    crc = crcTable[3][p[0] ^ crc >> 8] ^ crcTable[2][p[1] ^ (crc & 0xFF)] ^
+          crcTable[1][p[2]] ^ crcTable[0][p[3]];
+  }
+  return crcEN13575Bytewise(crc, p, length);
+}
+#endif
+
+#if CRC_SLICE >= 8
+uint16_t crcEN13575Slice8(uint16_t crc, const uint8_t *p, uint16_t length)
+{
+  for (; length >= 8; length -= 8, p += 8)
+  {
+    crc = crcTable[7][p[0] ^ crc >> 8] ^ crcTable[6][p[1] ^ (crc & 0xFF)] ^
+          crcTable[5][p[2]] ^ crcTable[4][p[3]] ^ crcTable[3][p[4]] ^
+          crcTable[2][p[5]] ^ crcTable[1][p[6]] ^ crcTable[0][p[7]];
+  }
+  return crcEN13575Bytewise(crc, p, length);
+}
+#endif
+
+uint16_t crcEN13575Update(uint16_t crc, const uint8_t *p, uint16_t length)
+{
+#if CRC_SLICE == 8
+  return crcEN13575Slice8(crc, p, length);
+#elif CRC_SLICE == 4
+  return crcEN13575Slice4(crc, p, length);
+#else
+  return crcEN13575Bytewise(crc, p, length);
+#endif
+}
+
+uint16_t crcEN13575(const uint8_t *payload, uint16_t length)
+{
+  return ~crcEN13575Update(0, payload, length);
 }
 
 uint16_t mirror(uint16_t crc, uint8_t bitnum)
@@ -100,4 +183,11 @@ void bin2hex(char *xp, uint8_t *bb, int n)
 {
     const char xx[]= "0123456789ABCDEF";
     while (--n >= 0) xp[n] = xx[(bb[n>>1] >> ((1 - (n&1)) << 2)) & 0xF];
-}
\ No newline at end of file
+}
+
+uint16_t formatALength(uint8_t lField)
+{
+  uint16_t blocks = 1; // L-field + 9 bytes
+  if (lField > 9) blocks += (lField - 9 + 15) / 16;
+  return 1 + lField + 2 * blocks;
+}